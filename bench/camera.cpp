@@ -0,0 +1,88 @@
+// Microbenchmark of the camera matrices, rebuilt every time against cached. Also checks the closed form
+// inverse_vp undoes vp, and that the cached frustum planes are the ones of get_vp().
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "src/camera.h"
+
+#define BENCH_CAMERAS 64
+#define BENCH_ITERATIONS 100000
+// Relative to the magnitude of the products, about a hundred float epsilons
+#define BENCH_IDENTITY_TOLERANCE 1e-5f
+
+static float get_random(float min, float max)
+{
+    return min + (max - min) * ((float)rand() / RAND_MAX);
+}
+
+static ::camera get_bench_camera()
+{
+    ::camera camera = camera::init(get_random(30, 100));
+    camera.set_aspect(get_random(0.5f, 3.0f));
+    camera.position = HMM_Vec3(get_random(-1000, 1000), get_random(-100, 100), get_random(-1000, 1000));
+    camera.rotate({get_random(-90, 90), get_random(-360, 360)});
+    return camera;
+}
+
+// How far inverse * m is off identity, relative to the rounding error float products of these magnitudes can have
+static float get_identity_error(hmm_mat4 const &inverse, hmm_mat4 const &m)
+{
+    float error = 0;
+    for (int col = 0; col < 4; ++col) {
+        for (int row = 0; row < 4; ++row) {
+            float product = 0, magnitude = 0;
+            for (int k = 0; k < 4; ++k) {
+                product += inverse.Elements[k][row] * m.Elements[col][k];
+                magnitude += fabsf(inverse.Elements[k][row] * m.Elements[col][k]);
+            }
+            // Exact zeros, e.g. a projection element times the view's last row, have nothing to round
+            float off = fabsf(product - (col == row));
+            error = HMM_MAX(error, magnitude > 0 ? off / magnitude : off);
+        }
+    }
+    return error;
+}
+
+int main()
+{
+    srand(1);
+    ::camera cameras[BENCH_CAMERAS];
+    for (int n = 0; n < BENCH_CAMERAS; ++n) {
+        cameras[n] = get_bench_camera();
+
+        float error = get_identity_error(cameras[n].get_inverse_vp(), cameras[n].get_vp());
+        if (error > BENCH_IDENTITY_TOLERANCE) {
+            fprintf(stderr, "get_inverse_vp: inverse_vp * vp is off identity by %g for camera %d\n", error, n);
+            return 1;
+        }
+
+        ::frustum frustum = get_frustum(cameras[n].get_vp());
+        if (memcmp(&frustum, &cameras[n].get_frustum(), sizeof frustum) != 0) {
+            fprintf(stderr, "get_frustum: cached planes differ from the planes of get_vp() for camera %d\n", n);
+            return 1;
+        }
+    }
+
+    // Kept, so the loops are not optimized away
+    volatile float sink = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int iteration = 0; iteration < BENCH_ITERATIONS; ++iteration) {
+        ::camera *camera = &cameras[iteration % BENCH_CAMERAS];
+        camera->dirty = true;
+        sink = sink + camera->get_vp().Elements[0][0] + camera->get_inverse_vp().Elements[0][0] + camera->get_frustum().planes[0].W;
+    }
+    std::chrono::duration<double> rebuilt = std::chrono::steady_clock::now() - start;
+
+    start = std::chrono::steady_clock::now();
+    for (int iteration = 0; iteration < BENCH_ITERATIONS; ++iteration) {
+        ::camera *camera = &cameras[iteration % BENCH_CAMERAS];
+        sink = sink + camera->get_vp().Elements[0][0] + camera->get_inverse_vp().Elements[0][0] + camera->get_frustum().planes[0].W;
+    }
+    std::chrono::duration<double> cached = std::chrono::steady_clock::now() - start;
+
+    printf("%-10s %10.3f us/frame\n", "Rebuilt", rebuilt.count() / BENCH_ITERATIONS * 1e6);
+    printf("%-10s %10.3f us/frame (x%.1f)\n", "Cached", cached.count() / BENCH_ITERATIONS * 1e6, rebuilt.count() / cached.count());
+    return 0;
+}
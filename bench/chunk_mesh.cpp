@@ -0,0 +1,126 @@
+// Microbenchmark of baking chunk meshes from their mesh maps, per face and greedy. Also checks every baked mesh
+// has as many indices as drawing each block with the cube_mesh_cache would, i.e. the sum of index_sizes[flags],
+// and that the greedy quads cover exactly the faces get_side_flags reports, each of them once.
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include "bench/common.h"
+#include "src/chunk_mesh.h"
+
+#define BENCH_ITERATIONS 4
+
+// Indices of each cube_mesh_cache entry, built the same way init_cube_mesh_cache does, without the GPU
+static void get_cube_index_sizes(size_t index_sizes[64])
+{
+    ::combined_buffer buffer = init_combined_buffer_malloc(8, 4*64*6, 6*64*6);
+    index_sizes[0] = 0;
+    for (cube_side_flags flags = 1; flags < 64; ++flags) {
+        size_t start_index_offset = buffer.index_count;
+        for (size_t quad_no = 0; quad_no < 6; ++quad_no) {
+            if (flags & cube_quad_side_flags[quad_no]) {
+                append_cube_quad_to_combined_buffer(&buffer, quad_no);
+            }
+        }
+        index_sizes[flags] = buffer.index_count-start_index_offset;
+    }
+    deinit_combined_buffer_malloc(&buffer);
+}
+
+// Draws the quads of a baked mesh back into a mesh map. Returns false if a face is covered twice.
+static bool rasterize_chunk_mesh(::chunk_mesh_buffer const *buffer, chunk_mesh_map &output)
+{
+    memset(output, 0, sizeof output);
+    for (size_t quad = 0; quad < buffer->vertex_count/4; ++quad) {
+        ::chunk_vertex const *vertices = &buffer->vertices[quad*4];
+        int side = vertices[0].side;
+        int min[3] = {CHUNK_SIZE, CHUNK_SIZE, CHUNK_SIZE}, max[3] = {0, 0, 0};
+        for (int i = 0; i < 4; ++i) {
+            int corner[3] = {vertices[i].x, vertices[i].y, vertices[i].z};
+            for (int a = 0; a < 3; ++a) {
+                min[a] = HMM_MIN(min[a], corner[a]);
+                max[a] = HMM_MAX(max[a], corner[a]);
+            }
+        }
+        // Faces of the positive sides lie on the far end of their block
+        int axis = side/2;
+        min[axis] -= side % 2 == 0;
+        max[axis] = min[axis] + 1;
+
+        for (int x = min[0]; x < max[0]; ++x) {
+            for (int z = min[2]; z < max[2]; ++z) {
+                for (int y = min[1]; y < max[1]; ++y) {
+                    if ((output[side][x][z] >> y) & 1) {
+                        return false;
+                    }
+                    output[side][x][z] |= chunk_column(1) << y;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+int main()
+{
+    static ::world world = {};
+    fill_bench_world(&world);
+    mesh_bench_world(&world);
+
+    size_t index_sizes[64];
+    get_cube_index_sizes(index_sizes);
+
+    ::chunk_mesh_buffer buffer = init_chunk_mesh_buffer(CHUNK_MESH_MAX_QUADS);
+    size_t quads = 0;
+    double seconds = 0;
+    WORLD_ITER(i, j, k) {
+        chunk_mesh_map const &mesh_map = bench_chunks[i][j][k].mesh_map;
+        size_t expected = 0;
+        CHUNK_ITER(x, y, z) {
+            expected += index_sizes[get_mesh_map_side_flags(mesh_map, x, y, z)];
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        for (int n = 0; n < BENCH_ITERATIONS; ++n) {
+            buffer.vertex_count = 0;
+            bake_chunk_mesh(mesh_map, &buffer);
+        }
+        seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        size_t baked = buffer.vertex_count/4*6;
+        if (baked != expected || buffer.side_offsets[CUBE_SIDE_COUNT] != count_chunk_mesh_quads(mesh_map)) {
+            fprintf(stderr, "bake_chunk_mesh: %zu indices in chunk %d %d %d, the cube mesh cache draws %zu\n", baked, i, j, k, expected);
+            return 1;
+        }
+        quads += buffer.side_offsets[CUBE_SIDE_COUNT];
+    }
+
+    const int chunk_count = RENDER_DISTANCE*RENDER_DISTANCE*RENDER_DISTANCE;
+    printf("%-22s %10.3f us/chunk, %.0f quads/chunk\n", "Per face bake", seconds / (chunk_count*BENCH_ITERATIONS) * 1e6, (double)quads / chunk_count);
+
+    size_t greedy_quads = 0;
+    double greedy_seconds = 0;
+    WORLD_ITER(i, j, k) {
+        // The faces get_side_flags reports, block by block
+        generate_chunk_mesh_map_scalar(&world, {i, j, k});
+        chunk_mesh_map const &mesh_map = bench_chunks[i][j][k].mesh_map;
+
+        auto start = std::chrono::steady_clock::now();
+        for (int n = 0; n < BENCH_ITERATIONS; ++n) {
+            buffer.vertex_count = 0;
+            bake_chunk_mesh_greedy(mesh_map, &buffer);
+        }
+        greedy_seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        static chunk_mesh_map covered;
+        if (!rasterize_chunk_mesh(&buffer, covered) || memcmp(covered, mesh_map, sizeof covered) != 0) {
+            fprintf(stderr, "bake_chunk_mesh_greedy: quads do not cover the faces of chunk %d %d %d exactly once\n", i, j, k);
+            return 1;
+        }
+        greedy_quads += buffer.side_offsets[CUBE_SIDE_COUNT];
+    }
+    deinit_chunk_mesh_buffer(&buffer);
+
+    printf("%-22s %10.3f us/chunk, %.0f quads/chunk (x%.1f fewer)\n", "Greedy bake", greedy_seconds / (chunk_count*BENCH_ITERATIONS) * 1e6,
+           (double)greedy_quads / chunk_count, (double)quads / greedy_quads);
+    return 0;
+}
@@ -0,0 +1,35 @@
+// World fixture shared by the microbenchmarks
+#ifndef CT_BENCH_COMMON_H
+#define CT_BENCH_COMMON_H
+
+#include <cstdlib>
+#include "src/world.h"
+
+// Chunks of the benchmark view, by slot
+static ::chunk bench_chunks[RENDER_DISTANCE][RENDER_DISTANCE][RENDER_DISTANCE];
+
+// Fills the world with a cave-ish pattern, so there are plenty of faces. Always the same blocks, as it reseeds rand.
+inline void fill_bench_world(::world *world)
+{
+    srand(1);
+    WORLD_ITER(i, j, k) {
+        ::chunk *chunk = &bench_chunks[i][j][k];
+        CHUNK_ITER(x, y, z) {
+            int wx = x+i*CHUNK_SIZE, wy = y+j*CHUNK_SIZE, wz = z+k*CHUNK_SIZE;
+            set_chunk_block(chunk, x, y, z, ((wx/5 + wy/3 + wz/7) % 3 == 0) != (rand() % 16 == 0));
+        }
+        chunk->position = get_world_chunk_position(world, {i, j, k});
+        put_world_chunk(world, {i, j, k}, chunk);
+    }
+}
+
+// Computes the mesh maps of the filled world and marks its chunks meshed, which is what block edits patch
+inline void mesh_bench_world(::world *world)
+{
+    WORLD_ITER(i, j, k) {
+        generate_chunk_mesh_map(world, {i, j, k});
+        bench_chunks[i][j][k].stage = CHUNK_STAGE_MESHED;
+    }
+}
+
+#endif
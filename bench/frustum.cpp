@@ -0,0 +1,96 @@
+// Microbenchmark of frustum culling on each instruction set. Also checks every kernel keeps exactly the boxes
+// the scalar one keeps, for cameras looking every which way.
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "src/camera.h"
+#include "src/frustum.h"
+
+// Not a multiple of 8, so the scalar tail of the SIMD kernels runs too
+#define BENCH_BOXES 4099
+#define BENCH_CAMERAS 16
+#define BENCH_ITERATIONS 200
+
+static float min_x[BENCH_BOXES], min_y[BENCH_BOXES], min_z[BENCH_BOXES];
+static float max_x[BENCH_BOXES], max_y[BENCH_BOXES], max_z[BENCH_BOXES];
+
+static float get_random(float min, float max)
+{
+    return min + (max - min) * ((float)rand() / RAND_MAX);
+}
+
+// Boxes from chunk sized down to block sized, scattered around the origin
+static void fill_boxes()
+{
+    srand(1);
+    for (int i = 0; i < BENCH_BOXES; ++i) {
+        float size = get_random(1, 32);
+        min_x[i] = get_random(-200, 200);
+        min_y[i] = get_random(-200, 200);
+        min_z[i] = get_random(-200, 200);
+        max_x[i] = min_x[i] + size;
+        max_y[i] = min_y[i] + size;
+        max_z[i] = min_z[i] + size;
+    }
+}
+
+static ::frustum get_bench_frustum(int n)
+{
+    ::camera camera = camera::init(45);
+    camera.set_aspect(n % 2 ? 16.0f/9.0f : 4.0f/3.0f);
+    camera.position = HMM_Vec3(get_random(-50, 50), get_random(-50, 50), get_random(-50, 50));
+    camera.rotate({get_random(-80, 80), n * 360.0f / BENCH_CAMERAS});
+    return camera.get_frustum();
+}
+
+int main()
+{
+    fill_boxes();
+    ::frustum_boxes boxes = {min_x, min_y, min_z, max_x, max_y, max_z, BENCH_BOXES};
+
+    ::frustum frustums[BENCH_CAMERAS];
+    for (int n = 0; n < BENCH_CAMERAS; ++n) {
+        frustums[n] = get_bench_frustum(n);
+    }
+
+    static bool reference[BENCH_CAMERAS][BENCH_BOXES];
+    static bool visible[BENCH_BOXES];
+    double scalar = 0;
+    for (int isa = 0; isa < CPU_ISA_COUNT; ++isa) {
+        if (!(frustum_cull_kernels.available & CPU_ISA_BIT(isa))) {
+            continue;
+        }
+        if (!cpu_isa_supported((::cpu_isa)isa)) {
+            printf("%-10s %12s\n", cpu_isa_names[isa], "unsupported");
+            continue;
+        }
+        set_cpu_isa(&frustum_cull_kernels, (::cpu_isa)isa);
+
+        size_t kept = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (int iteration = 0; iteration < BENCH_ITERATIONS; ++iteration) {
+            for (int n = 0; n < BENCH_CAMERAS; ++n) {
+                kept += cull_frustum_boxes(&frustums[n], &boxes, iteration == 0 && isa == CPU_ISA_SCALAR ? reference[n] : visible);
+            }
+        }
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        double boxes_per_second = (double)BENCH_ITERATIONS * BENCH_CAMERAS * BENCH_BOXES / elapsed.count();
+
+        for (int n = 0; n < BENCH_CAMERAS; ++n) {
+            cull_frustum_boxes(&frustums[n], &boxes, visible);
+            if (memcmp(reference[n], visible, sizeof visible) != 0) {
+                fprintf(stderr, "%s: visible boxes differ from the scalar kernel for camera %d\n", cpu_isa_names[isa], n);
+                return 1;
+            }
+        }
+
+        if (isa == CPU_ISA_SCALAR) {
+            scalar = boxes_per_second;
+        }
+        printf("%-10s %12.1f Mboxes/s (x%.1f), %.1f%% visible\n", cpu_isa_names[isa], boxes_per_second / 1e6, boxes_per_second / scalar,
+               100.0 * kept / ((double)BENCH_ITERATIONS * BENCH_CAMERAS * BENCH_BOXES));
+    }
+
+    return 0;
+}
@@ -0,0 +1,156 @@
+// Microbenchmark of the job system: empty job throughput, fan-out/fan-in latency and nested parallel_for_3d
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "src/world.h"
+#include "src/jobs.h"
+
+#define BENCH_EMPTY_JOBS 200000
+// Submitted between waits, well within a deque, so no job runs inline because the deque is full
+#define BENCH_EMPTY_JOB_BATCH (JOBS_DEQUE_CAPACITY/2)
+#define BENCH_FAN_OUT_ROUNDS 2000
+#define BENCH_NESTED_ITERATIONS 10
+
+static double seconds_since(std::chrono::steady_clock::time_point start)
+{
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count();
+}
+
+static void run_empty_job(void *context, void *data)
+{
+    (void)context;
+    (void)data;
+}
+
+static void run_spawning_job(void *context, void *data)
+{
+    ::job_system *jobs = (::job_system*)context;
+    (void)data;
+    ::job_counter batch = {};
+    for (int i = 0; i < BENCH_EMPTY_JOBS; i += BENCH_EMPTY_JOB_BATCH) {
+        for (int j = i; j < i + BENCH_EMPTY_JOB_BATCH && j < BENCH_EMPTY_JOBS; ++j) {
+            submit_child_job(jobs, {run_empty_job, nullptr, nullptr}, &batch);
+        }
+        wait_for_counter(jobs, &batch);
+    }
+}
+
+static void bench_empty_jobs(::job_system *jobs)
+{
+    ::job_counter counter = {};
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < BENCH_EMPTY_JOBS; i += BENCH_EMPTY_JOB_BATCH) {
+        for (int j = i; j < i + BENCH_EMPTY_JOB_BATCH && j < BENCH_EMPTY_JOBS; ++j) {
+            submit_job(jobs, {run_empty_job, nullptr, nullptr}, &counter);
+        }
+        wait_for_counter(jobs, &counter);
+    }
+    double from_main = BENCH_EMPTY_JOBS / seconds_since(start);
+
+    // Same jobs, but spawned as children from a worker's own deque
+    start = std::chrono::steady_clock::now();
+    submit_job(jobs, {run_spawning_job, jobs, nullptr}, &counter);
+    wait_for_counter(jobs, &counter);
+    double from_worker = BENCH_EMPTY_JOBS / seconds_since(start);
+
+    printf("%-28s %12.1f jobs/s (batches of %d)\n", "Empty jobs, from main", from_main, BENCH_EMPTY_JOB_BATCH);
+    printf("%-28s %12.1f jobs/s (batches of %d)\n", "Empty jobs, from a job", from_worker, BENCH_EMPTY_JOB_BATCH);
+}
+
+static void bench_fan_out(::job_system *jobs)
+{
+    ::job_counter counter = {};
+    int width = jobs->worker_count + 1;
+
+    auto start = std::chrono::steady_clock::now();
+    for (int round = 0; round < BENCH_FAN_OUT_ROUNDS; ++round) {
+        for (int i = 0; i < width; ++i) {
+            submit_job(jobs, {run_empty_job, nullptr, nullptr}, &counter);
+        }
+        wait_for_counter(jobs, &counter);
+    }
+    double latency = seconds_since(start) / BENCH_FAN_OUT_ROUNDS;
+
+    printf("%-28s %12.2f us (%d jobs)\n", "Fan-out/fan-in round trip", latency * 1e6, width);
+}
+
+struct nested_bench {
+    ::job_system *jobs;
+    // One byte per block of every view slot
+    uint8_t (*visited)[CHUNK_SIZE][CHUNK_SIZE][CHUNK_SIZE];
+};
+
+struct nested_bench_chunk {
+    ::nested_bench *bench;
+    int slot;
+};
+
+static void visit_block(void *context, int x, int y, int z)
+{
+    ::nested_bench_chunk *chunk = (::nested_bench_chunk*)context;
+    chunk->bench->visited[chunk->slot][x][y][z]++;
+}
+
+static void visit_chunk(void *context, int i, int j, int k)
+{
+    ::nested_bench *bench = (::nested_bench*)context;
+    ::nested_bench_chunk chunk = {bench, (i*RENDER_DISTANCE + j)*RENDER_DISTANCE + k};
+    parallel_for_3d(bench->jobs, CHUNK_SIZE, CHUNK_SIZE, CHUNK_SIZE, 1024, visit_block, &chunk);
+}
+
+static bool bench_nested_parallel_for(::job_system *jobs)
+{
+    const int slots = RENDER_DISTANCE*RENDER_DISTANCE*RENDER_DISTANCE;
+    ::nested_bench bench = {jobs, (uint8_t(*)[CHUNK_SIZE][CHUNK_SIZE][CHUNK_SIZE])calloc(slots, sizeof *bench.visited)};
+
+    // The same walk on one thread, for scale
+    auto start = std::chrono::steady_clock::now();
+    for (int n = 0; n < BENCH_NESTED_ITERATIONS; ++n) {
+        WORLD_ITER(i, j, k) {
+            ::nested_bench_chunk chunk = {&bench, (i*RENDER_DISTANCE + j)*RENDER_DISTANCE + k};
+            CHUNK_ITER(x, y, z) {
+                visit_block(&chunk, x, y, z);
+            }
+        }
+    }
+    double serial = seconds_since(start) / BENCH_NESTED_ITERATIONS;
+
+    start = std::chrono::steady_clock::now();
+    for (int n = 0; n < BENCH_NESTED_ITERATIONS; ++n) {
+        parallel_for_3d(jobs, RENDER_DISTANCE, RENDER_DISTANCE, RENDER_DISTANCE, 1, visit_chunk, &bench);
+    }
+    double parallel = seconds_since(start) / BENCH_NESTED_ITERATIONS;
+
+    // Every block has to be visited exactly once per pass
+    bool ok = true;
+    for (int slot = 0; slot < slots && ok; ++slot) {
+        CHUNK_ITER(x, y, z) {
+            if (bench.visited[slot][x][y][z] != 2*BENCH_NESTED_ITERATIONS) {
+                fprintf(stderr, "Nested parallel_for: block %d %d %d of slot %d visited %d times\n", x, y, z, slot, bench.visited[slot][x][y][z]);
+                ok = false;
+                break;
+            }
+        }
+    }
+    free(bench.visited);
+
+    printf("%-28s %12.2f ms (serial %.2f ms)\n", "Nested parallel_for", parallel * 1e3, serial * 1e3);
+    return ok;
+}
+
+int main()
+{
+    static ::job_system jobs;
+    init_job_system(&jobs, 0);
+    printf("Job system: %d workers\n", jobs.worker_count);
+
+    bench_empty_jobs(&jobs);
+    bench_fan_out(&jobs);
+    bool ok = bench_nested_parallel_for(&jobs);
+
+    deinit_job_system(&jobs);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,62 @@
+// Microbenchmark of chunk mesh map generation: column bitmask kernels on each instruction set
+// against the scalar get_side_flags path
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include "bench/common.h"
+#include "src/face_mask.h"
+
+#define BENCH_ITERATIONS 20
+#define BENCH_KERNEL_ITERATIONS 2000
+
+static double bench(::world *world, void (*generate)(::world *, vec3i), int iterations)
+{
+    auto start = std::chrono::steady_clock::now();
+    for (int n = 0; n < iterations; ++n) {
+        WORLD_ITER(i, j, k) {
+            generate(world, {i, j, k});
+        }
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return (double)iterations * RENDER_DISTANCE*RENDER_DISTANCE*RENDER_DISTANCE / elapsed.count();
+}
+
+int main()
+{
+    static ::world world = {};
+    fill_bench_world(&world);
+
+    static chunk_column reference[RENDER_DISTANCE][RENDER_DISTANCE][RENDER_DISTANCE][CUBE_SIDE_COUNT][CHUNK_SIZE][CHUNK_SIZE];
+    double scalar = bench(&world, generate_chunk_mesh_map_scalar, BENCH_ITERATIONS);
+    WORLD_ITER(i, j, k) {
+        memcpy(reference[i][j][k], bench_chunks[i][j][k].mesh_map, sizeof bench_chunks[i][j][k].mesh_map);
+    }
+
+    printf("%-10s %12.1f chunks/s\n", "Per block", scalar);
+
+    for (int isa = 0; isa < CPU_ISA_COUNT; ++isa) {
+        if (!(face_mask_kernels.available & CPU_ISA_BIT(isa))) {
+            continue;
+        }
+        if (!cpu_isa_supported((::cpu_isa)isa)) {
+            printf("%-10s %12s\n", cpu_isa_names[isa], "unsupported");
+            continue;
+        }
+        set_cpu_isa(&face_mask_kernels, (::cpu_isa)isa);
+
+        WORLD_ITER(i, j, k) {
+            memset(bench_chunks[i][j][k].mesh_map, 0, sizeof bench_chunks[i][j][k].mesh_map);
+        }
+        double bitwise = bench(&world, generate_chunk_mesh_map, BENCH_KERNEL_ITERATIONS);
+        WORLD_ITER(i, j, k) {
+            if (memcmp(reference[i][j][k], bench_chunks[i][j][k].mesh_map, sizeof bench_chunks[i][j][k].mesh_map) != 0) {
+                fprintf(stderr, "%s: mesh map mismatch in chunk %d %d %d\n", cpu_isa_names[isa], i, j, k);
+                return 1;
+            }
+        }
+
+        printf("%-10s %12.1f chunks/s (x%.1f)\n", cpu_isa_names[isa], bitwise, bitwise/scalar);
+    }
+
+    return 0;
+}
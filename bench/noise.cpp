@@ -0,0 +1,157 @@
+// Microbenchmark of the noise kernels on each instruction set, in samples per second, and of chunk
+// density sampled on coarse lattices against every block. Also checks every kernel against golden
+// values, so results stay bit-identical across ISAs and changes.
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "src/noise.h"
+
+#define BENCH_CHUNKS 8
+#define BENCH_POINTS 1001
+// Same as the threshold of the tunnels biome in world.cpp
+#define BENCH_DENSITY_THRESHOLD -0.1f
+
+static const ::noise_params bench_noises[NOISE_TYPE_COUNT] = {
+    {NOISE_TYPE_PERLIN, 1, 1.0f/16, 1, 2.0f, 0.5f},
+    {NOISE_TYPE_FBM, 2, 1.0f/48, 4, 2.0f, 0.5f},
+    {NOISE_TYPE_RIDGED, 3, 1.0f/64, 3, 2.0f, 0.5f},
+    {NOISE_TYPE_WORLEY, 4, 1.0f/12, 1, 2.0f, 0.5f},
+};
+
+// FNV-1a over the bits of chunk (-1, 0, 2) and of BENCH_POINTS scattered points, from the scalar kernel
+static const uint64_t golden_hashes[NOISE_TYPE_COUNT] = {
+    0x29E244C27BB51BCAull,
+    0x44290AA3D3DAA8FDull,
+    0xA3AD82D2477F77E7ull,
+    0x5C174F8DEBAD7D98ull,
+};
+
+// Cave rock like generate_chunk makes, at a few lattice steps per octave. generate_chunk uses 8 4 4 2.
+#define BENCH_LATTICES 5
+static const int bench_lattice_steps[BENCH_LATTICES][4] = {
+    {1, 1, 1, 1},
+    {4, 2, 1, 1},
+    {8, 4, 2, 1},
+    {8, 4, 4, 2},
+    {8, 8, 8, 8},
+};
+
+// The golden hash of bench_lattice_steps[3]
+static const uint64_t golden_lattice_hash = 0xE14E0162604A107Aull;
+
+static ::noise_params get_bench_lattice_noise(int lattice)
+{
+    ::noise_params output = {NOISE_TYPE_FBM, 0xCA7E5EED, 1.0f/48, 4, 2.0f, 0.5f};
+    memcpy(output.lattice_steps, bench_lattice_steps[lattice], sizeof bench_lattice_steps[lattice]);
+    return output;
+}
+
+static uint64_t hash_floats(uint64_t hash, float const *values, size_t count)
+{
+    unsigned char const *bytes = (unsigned char const*)values;
+    for (size_t i = 0; i < count*sizeof *values; ++i) {
+        hash = (hash ^ bytes[i]) * 0x100000001B3ull;
+    }
+    return hash;
+}
+
+static float points[3][BENCH_POINTS];
+
+static uint64_t hash_noise(::noise_params const *params)
+{
+    static chunk_density density;
+    static float values[BENCH_POINTS];
+    sample_chunk_noise(params, {-1, 0, 2}, density);
+    // An odd count, so the scalar tail of the wide kernels gets checked too
+    sample_noise(params, points[0], points[1], points[2], values, BENCH_POINTS);
+
+    uint64_t hash = 0xCBF29CE484222325ull;
+    hash = hash_floats(hash, &density[0][0][0], CHUNK_SIZE*CHUNK_SIZE*CHUNK_SIZE);
+    return hash_floats(hash, values, BENCH_POINTS);
+}
+
+int main()
+{
+    srand(1);
+    for (int i = 0; i < BENCH_POINTS; ++i) {
+        for (int a = 0; a < 3; ++a) {
+            points[a][i] = (rand() % 200000 - 100000) / 7.0f;
+        }
+    }
+
+    bool golden = true;
+    for (int isa = 0; isa < CPU_ISA_COUNT; ++isa) {
+        if (!(noise_kernels.available & CPU_ISA_BIT(isa))) {
+            continue;
+        }
+        if (!cpu_isa_supported((::cpu_isa)isa)) {
+            printf("%-8s %12s\n", cpu_isa_names[isa], "unsupported");
+            continue;
+        }
+        set_cpu_isa(&noise_kernels, (::cpu_isa)isa);
+
+        for (int type = 0; type < NOISE_TYPE_COUNT; ++type) {
+            uint64_t hash = hash_noise(&bench_noises[type]);
+            if (hash != golden_hashes[type]) {
+                fprintf(stderr, "%s %s: hash %016llx does not match the golden %016llx\n", cpu_isa_names[isa], noise_type_names[type], (unsigned long long)hash, (unsigned long long)golden_hashes[type]);
+                golden = false;
+                continue;
+            }
+
+            static chunk_density density;
+            auto start = std::chrono::steady_clock::now();
+            for (int n = 0; n < BENCH_CHUNKS; ++n) {
+                sample_chunk_noise(&bench_noises[type], {n, 0, 0}, density);
+            }
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            double samples = (double)BENCH_CHUNKS * CHUNK_SIZE*CHUNK_SIZE*CHUNK_SIZE / elapsed.count();
+            printf("%-8s %-8s %8.1f M samples/s %8.1f us/chunk\n", cpu_isa_names[isa], noise_type_names[type], samples * 1e-6, elapsed.count() / BENCH_CHUNKS * 1e6);
+        }
+
+        ::noise_params lattice_noise = get_bench_lattice_noise(3);
+        uint64_t hash = hash_noise(&lattice_noise);
+        if (hash != golden_lattice_hash) {
+            fprintf(stderr, "%s lattice: hash %016llx does not match the golden %016llx\n", cpu_isa_names[isa], (unsigned long long)hash, (unsigned long long)golden_lattice_hash);
+            golden = false;
+        }
+    }
+
+    set_cpu_isa(&noise_kernels, get_best_cpu_isa(&noise_kernels));
+    printf("\nCave rock on %s, lattice steps per octave against every block\n", cpu_isa_names[get_cpu_isa(&noise_kernels)]);
+
+    static chunk_density reference[BENCH_CHUNKS], density;
+    double reference_seconds = 0;
+    for (int lattice = 0; lattice < BENCH_LATTICES; ++lattice) {
+        ::noise_params noise = get_bench_lattice_noise(lattice);
+        size_t different = 0;
+        float max_error = 0;
+        double seconds = 0;
+        for (int n = 0; n < BENCH_CHUNKS; ++n) {
+            // The first lattice samples every block, it is the reference
+            chunk_density &sampled = lattice == 0 ? reference[n] : density;
+            auto start = std::chrono::steady_clock::now();
+            sample_chunk_noise(&noise, {n, n % 3 - 1, -n}, sampled);
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            seconds += elapsed.count();
+
+            // Blocks that came out differently, the density itself does not show
+            float const *output = &sampled[0][0][0], *expected = &reference[n][0][0][0];
+            for (int i = 0; i < CHUNK_SIZE*CHUNK_SIZE*CHUNK_SIZE; ++i) {
+                different += (output[i] > BENCH_DENSITY_THRESHOLD) != (expected[i] > BENCH_DENSITY_THRESHOLD);
+                max_error = HMM_MAX(max_error, fabsf(output[i] - expected[i]));
+            }
+        }
+
+        if (lattice == 0) {
+            reference_seconds = seconds;
+        }
+        int const *steps = bench_lattice_steps[lattice];
+        double block_count = (double)BENCH_CHUNKS * CHUNK_SIZE*CHUNK_SIZE*CHUNK_SIZE;
+        printf("%d %d %d %d  %10.1f us/chunk (x%5.1f) %8.3f%% blocks differ, density error <= %.4f\n",
+               steps[0], steps[1], steps[2], steps[3], seconds / BENCH_CHUNKS * 1e6, reference_seconds / seconds, 100 * different / block_count, max_error);
+    }
+
+    return golden ? 0 : 1;
+}
@@ -0,0 +1,48 @@
+// Microbenchmark of profiler zones: the cost of a zone with recording off and on
+#include <chrono>
+#include <cstdio>
+#include "src/profiler.h"
+
+#define BENCH_ZONES 10000000
+
+// Kept out of line, so the loop is not folded away
+__attribute__((noinline)) static void zone(int *counter)
+{
+    PROFILE_ZONE("zone");
+    ++*(volatile int*)counter;
+}
+
+__attribute__((noinline)) static void no_zone(int *counter)
+{
+    ++*(volatile int*)counter;
+}
+
+static double bench(void (*function)(int *))
+{
+    int counter = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < BENCH_ZONES; ++i) {
+        function(&counter);
+    }
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / BENCH_ZONES;
+}
+
+int main()
+{
+    double baseline = bench(no_zone);
+
+    set_profiler_enabled(false);
+    double disabled = bench(zone);
+
+    set_profiler_enabled(true);
+    double enabled = bench(zone);
+    set_profiler_enabled(false);
+
+    printf("%-28s %8.2f ns/call\n", "No zone", baseline);
+    printf("%-28s %8.2f ns/call (+%.2f)\n", "Zone, recording off", disabled, disabled - baseline);
+    printf("%-28s %8.2f ns/call (+%.2f)\n", "Zone, recording on", enabled, enabled - baseline);
+
+    deinit_profiler();
+    return 0;
+}
@@ -0,0 +1,74 @@
+// Microbenchmark of single block edits: set_block patching the mesh maps in place against
+// recomputing and rebaking the whole chunk, which is what an edit cost before
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "bench/common.h"
+#include "src/chunk_mesh.h"
+
+#define BENCH_EDITS 100000
+#define BENCH_CHUNK_ITERATIONS 200
+
+// A block in a box of size blocks centered on the middle of the view, which is a chunk corner
+static vec3i get_random_block(::world const *world, int size)
+{
+    vec3i origin = get_world_chunk_position(world, {0, 0, 0}) * CHUNK_SIZE + (RENDER_DISTANCE*CHUNK_SIZE - size)/2;
+    return origin + vec3i{rand() % size, rand() % size, rand() % size};
+}
+
+// Flips random blocks, returns the seconds per edit
+static double bench_edits(::world *world, int size)
+{
+    auto start = std::chrono::steady_clock::now();
+    for (int n = 0; n < BENCH_EDITS; ++n) {
+        vec3i pos = get_random_block(world, size);
+        set_block(world, pos, !get_block(world, pos));
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / BENCH_EDITS;
+}
+
+int main()
+{
+    static ::world world = {};
+    fill_bench_world(&world);
+    mesh_bench_world(&world);
+
+    srand(2);
+    // Edits all over the world miss the cache on every mesh map lookup, edits around the player mostly hit it
+    double world_edit = bench_edits(&world, RENDER_DISTANCE*CHUNK_SIZE);
+    double local_edit = bench_edits(&world, 16);
+
+    // The patched mesh maps have to match mesh maps computed from scratch
+    static chunk_mesh_map patched;
+    WORLD_ITER(i, j, k) {
+        memcpy(patched, bench_chunks[i][j][k].mesh_map, sizeof patched);
+        generate_chunk_mesh_map(&world, {i, j, k});
+        if (memcmp(patched, bench_chunks[i][j][k].mesh_map, sizeof patched) != 0) {
+            fprintf(stderr, "set_block: mesh map mismatch in chunk %d %d %d\n", i, j, k);
+            return 1;
+        }
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    for (int n = 0; n < BENCH_CHUNK_ITERATIONS; ++n) {
+        generate_chunk_mesh_map(&world, {n % RENDER_DISTANCE, 0, 0});
+    }
+    std::chrono::duration<double> mesh_maps = std::chrono::steady_clock::now() - start;
+
+    ::chunk_mesh_buffer buffer = init_chunk_mesh_buffer(CHUNK_MESH_MAX_QUADS);
+    start = std::chrono::steady_clock::now();
+    for (int n = 0; n < BENCH_CHUNK_ITERATIONS; ++n) {
+        buffer.vertex_count = 0;
+        bake_chunk_mesh_greedy(bench_chunks[n % RENDER_DISTANCE][0][0].mesh_map, &buffer);
+    }
+    std::chrono::duration<double> bakes = std::chrono::steady_clock::now() - start;
+    deinit_chunk_mesh_buffer(&buffer);
+
+    printf("%-22s %10.3f us\n", "set_block, whole view", world_edit * 1e6);
+    printf("%-22s %10.3f us\n", "set_block, 16^3 box", local_edit * 1e6);
+    printf("%-22s %10.3f us\n", "Chunk mesh map", mesh_maps.count() / BENCH_CHUNK_ITERATIONS * 1e6);
+    printf("%-22s %10.3f us (on a worker)\n", "Greedy chunk bake", bakes.count() / BENCH_CHUNK_ITERATIONS * 1e6);
+    return 0;
+}
@@ -0,0 +1,91 @@
+// Microbenchmark of chunk generation with the terrain column cache: a view of chunks with the 2D fields
+// shared by each stack of chunks, against computing them for every chunk. Also generates the view on the
+// job system, sharing one cache between the workers, and checks it comes out the same.
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include "bench/common.h"
+#include "src/terrain_column.h"
+
+static ::chunk_column reference[RENDER_DISTANCE][RENDER_DISTANCE][RENDER_DISTANCE][CHUNK_SIZE][CHUNK_SIZE];
+
+// The view spans the ground, from caves to sky
+static vec3i get_bench_chunk_position(int i, int j, int k)
+{
+    return {i - RENDER_DISTANCE/2, j - RENDER_DISTANCE/2, k - RENDER_DISTANCE/2};
+}
+
+struct bench_generate_context {
+    ::terrain_column_cache *columns;
+};
+
+static void generate_bench_chunk(void *context, int i, int j, int k)
+{
+    ::terrain_column_cache *columns = ((::bench_generate_context*)context)->columns;
+    generate_chunk(columns, &bench_chunks[i][j][k], get_bench_chunk_position(i, j, k));
+}
+
+// Generates the view, x and z fastest when interleaved, so a single slot cache misses on every chunk. Returns seconds per chunk.
+static double bench_generate(::terrain_column_cache *columns, bool interleaved)
+{
+    auto start = std::chrono::steady_clock::now();
+    for (int a = 0; a < RENDER_DISTANCE; ++a) {
+        for (int b = 0; b < RENDER_DISTANCE; ++b) {
+            for (int c = 0; c < RENDER_DISTANCE; ++c) {
+                ::bench_generate_context context = {columns};
+                if (interleaved) {
+                    generate_bench_chunk(&context, b, a, c);
+                } else {
+                    generate_bench_chunk(&context, a, c, b);
+                }
+            }
+        }
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / (RENDER_DISTANCE*RENDER_DISTANCE*RENDER_DISTANCE);
+}
+
+int main()
+{
+    static ::terrain_column_cache unshared, shared, parallel;
+    init_terrain_column_cache(&unshared, 1);
+    init_terrain_column_cache(&shared, TERRAIN_COLUMN_CACHE_CAPACITY);
+    init_terrain_column_cache(&parallel, TERRAIN_COLUMN_CACHE_CAPACITY);
+
+    double unshared_time = bench_generate(&unshared, true);
+    double shared_time = bench_generate(&shared, false);
+    WORLD_ITER(i, j, k) {
+        memcpy(reference[i][j][k], bench_chunks[i][j][k].data, sizeof bench_chunks[i][j][k].data);
+    }
+
+    ::job_system jobs;
+    init_job_system(&jobs, 0);
+    ::bench_generate_context context = {&parallel};
+    auto start = std::chrono::steady_clock::now();
+    parallel_for_3d(&jobs, RENDER_DISTANCE, RENDER_DISTANCE, RENDER_DISTANCE, 1, generate_bench_chunk, &context);
+    std::chrono::duration<double> parallel_time = std::chrono::steady_clock::now() - start;
+    deinit_job_system(&jobs);
+
+    int result = 0;
+    WORLD_ITER(i, j, k) {
+        if (memcmp(reference[i][j][k], bench_chunks[i][j][k].data, sizeof bench_chunks[i][j][k].data) != 0) {
+            fprintf(stderr, "terrain_column: chunk %d %d %d differs when generated in parallel\n", i, j, k);
+            result = 1;
+        }
+    }
+
+    auto column_start = std::chrono::steady_clock::now();
+    static ::terrain_column column;
+    generate_terrain_column(&column, 0, 0);
+    std::chrono::duration<double> column_time = std::chrono::steady_clock::now() - column_start;
+
+    printf("%-26s %10.1f us\n", "Terrain column fields", column_time.count() * 1e6);
+    printf("%-26s %10.1f us/chunk, %zu column misses\n", "Chunks, fields per chunk", unshared_time * 1e6, unshared.misses);
+    printf("%-26s %10.1f us/chunk, %zu column misses (x%.1f)\n", "Chunks, fields per column", shared_time * 1e6, shared.misses, unshared_time / shared_time);
+    printf("%-26s %10.1f us/chunk, %zu column misses, %zu hits\n", "Chunks on the workers", parallel_time.count() / (RENDER_DISTANCE*RENDER_DISTANCE*RENDER_DISTANCE) * 1e6, parallel.misses, parallel.hits);
+
+    deinit_terrain_column_cache(&unshared);
+    deinit_terrain_column_cache(&shared);
+    deinit_terrain_column_cache(&parallel);
+    return result;
+}
@@ -0,0 +1,388 @@
+// Headless benchmark: flies the camera along scripted paths, or along an input recording of the app,
+// on sokol_gfx's dummy backend, so the engine can be profiled without a window or a GPU.
+// Fails if the main thread ran a chunk generation or mesh bake in any frame, those belong on the workers.
+// A recording is first flown twice with every frame's chunk jobs drained, and fails if the two load different chunks.
+// Usage: bench_headless [--frames frames per flight] [--rate frame rate, 0 to run frames back to back]
+//                       [--trace trace path] [--replay input recording, flown instead of the scripted paths]
+//                       [--draw baked|instanced|per-voxel|all, how chunks are drawn, all flies every path once per mode]
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#define SOKOL_IMPL
+#define SOKOL_DUMMY_BACKEND
+#include "lib/sokol/sokol_gfx.h"
+#undef SOKOL_IMPL
+extern "C" {
+#include "bin/shaders.h"
+}
+
+#include "src/camera.h"
+#include "src/chunk_mesh.h"
+#include "src/frustum.h"
+#include "src/input.h"
+#include "src/input_record.h"
+#include "src/jobs.h"
+#include "src/profiler.h"
+#include "src/render.h"
+#include "src/simulation.h"
+#include "src/world.h"
+
+#define BENCH_DEFAULT_FRAMES 600
+#define BENCH_DEFAULT_FRAME_RATE 60
+#define BENCH_WIDTH 1048
+#define BENCH_HEIGHT 768
+// Same as the default in the app
+#define BENCH_STREAMING_BUDGET_MS 2.0
+
+enum bench_flight {
+    // Flies forward, streaming in a new layer of chunks every CHUNK_SIZE frames
+    BENCH_FLIGHT_STRAIGHT,
+    // Turns around in place, so culling sees every direction
+    BENCH_FLIGHT_ORBIT,
+    // Turns while flying forward and bobbing up and down
+    BENCH_FLIGHT_SPIRAL,
+    // Flies like the app did when the input was recorded, one recorded frame per frame
+    BENCH_FLIGHT_REPLAY,
+    BENCH_FLIGHT_COUNT
+};
+
+static const char *bench_flight_names[BENCH_FLIGHT_COUNT] = {"straight", "orbit", "spiral", "replay"};
+// Indexed by chunk_draw_mode
+static const char *bench_draw_mode_names[CHUNK_DRAW_MODE_COUNT] = {"baked", "instanced", "per-voxel"};
+
+static void fly(::camera *camera, ::bench_flight flight, int frame, ::input_replay *replay, ::simulation *simulation)
+{
+    switch (flight) {
+        case BENCH_FLIGHT_STRAIGHT:
+            camera->move(1, 0, 0);
+            break;
+        case BENCH_FLIGHT_ORBIT:
+            camera->rotate({0, 1});
+            break;
+        case BENCH_FLIGHT_SPIRAL:
+            camera->rotate({0, 0.5f});
+            camera->move(0.5f, 0, frame % 240 < 120 ? 0.25f : -0.25f);
+            break;
+        case BENCH_FLIGHT_REPLAY: {
+            // Same as handle_camera in the app
+            ::input_frame input_frame;
+            if (replay_input_frame(replay, &input_frame)) {
+                advance_simulation(simulation, input_frame.input, input_frame.mouse_locked, input_frame.duration);
+                *camera = get_simulation_camera(simulation, input_frame.aspect);
+            }
+        } break;
+        default:
+            break;
+    }
+}
+
+// The dummy backend runs no shaders, it only needs the uniform blocks to validate sg_apply_uniforms
+static sg_shader_desc get_dummy_shader_desc()
+{
+    sg_shader_desc desc = {};
+    desc.vs.uniform_blocks[SLOT_vs_params].size = sizeof(vs_params_t);
+    desc.vs.uniform_blocks[SLOT_vs_params].uniforms[0].name = "mvp";
+    desc.vs.uniform_blocks[SLOT_vs_params].uniforms[0].type = SG_UNIFORMTYPE_MAT4;
+    desc.label = "cube-shader-dummy";
+    return desc;
+}
+
+static sg_shader_desc get_dummy_chunk_shader_desc()
+{
+    sg_shader_desc desc = {};
+    desc.vs.uniform_blocks[SLOT_chunk_vs_params].size = sizeof(chunk_vs_params_t);
+    desc.vs.uniform_blocks[SLOT_chunk_vs_params].uniforms[0].name = "vp";
+    desc.vs.uniform_blocks[SLOT_chunk_vs_params].uniforms[0].type = SG_UNIFORMTYPE_MAT4;
+    desc.vs.uniform_blocks[SLOT_chunk_vs_params].uniforms[1].name = "chunk_offset";
+    desc.vs.uniform_blocks[SLOT_chunk_vs_params].uniforms[1].type = SG_UNIFORMTYPE_FLOAT4;
+    desc.label = "chunk-shader-dummy";
+    return desc;
+}
+
+static sg_shader_desc get_dummy_voxel_shader_desc()
+{
+    sg_shader_desc desc = {};
+    desc.vs.uniform_blocks[SLOT_voxel_vs_params].size = sizeof(voxel_vs_params_t);
+    desc.vs.uniform_blocks[SLOT_voxel_vs_params].uniforms[0].name = "vp";
+    desc.vs.uniform_blocks[SLOT_voxel_vs_params].uniforms[0].type = SG_UNIFORMTYPE_MAT4;
+    desc.vs.uniform_blocks[SLOT_voxel_vs_params].uniforms[1].name = "chunk_offset";
+    desc.vs.uniform_blocks[SLOT_voxel_vs_params].uniforms[1].type = SG_UNIFORMTYPE_FLOAT4;
+    desc.vs.uniform_blocks[SLOT_voxel_vs_params].uniforms[2].name = "side";
+    desc.vs.uniform_blocks[SLOT_voxel_vs_params].uniforms[2].type = SG_UNIFORMTYPE_FLOAT4;
+    desc.label = "voxel-shader-dummy";
+    return desc;
+}
+
+static double get_percentile(double const *sorted, int count, double percentile)
+{
+    int index = (int)(percentile / 100.0 * (count - 1) + 0.5);
+    return sorted[index];
+}
+
+static int count_input_replay_frames(::input_replay const *replay)
+{
+    ::input_replay counter = *replay;
+    ::input_frame input_frame;
+    int frames = 0;
+    while (replay_input_frame(&counter, &input_frame)) {
+        ++frames;
+    }
+    return frames;
+}
+
+// Zones of the jobs that take whole milliseconds, the frame must never wait on one of them
+static const char *bench_worker_zones[] = {"run_chunk_generate_job", "run_chunk_mesh_job"};
+
+// Counts the worker zones the calling thread recorded since begin
+static int count_blocking_zones(uint64_t begin)
+{
+    static ::profiler_record records[PROFILER_RING_SIZE];
+    size_t count = read_profiler_thread_events(begin, records, PROFILER_RING_SIZE);
+    int blocking = 0;
+    for (size_t i = 0; i < count; ++i) {
+        for (char const *zone : bench_worker_zones) {
+            blocking += strcmp(records[i].name, zone) == 0;
+        }
+    }
+    return blocking;
+}
+
+// Folds which chunks are in the view, and how far along they are, into an FNV-1a hash
+static uint64_t hash_world_loads(uint64_t hash, ::world const *world)
+{
+    WORLD_ITER(i, j, k) {
+        ::chunk const *chunk = world->chunks[i][j][k];
+        int values[4] = {0, 0, 0, -1};
+        if (chunk) {
+            values[0] = chunk->position.x;
+            values[1] = chunk->position.y;
+            values[2] = chunk->position.z;
+            values[3] = chunk->stage;
+        }
+        unsigned char const *bytes = (unsigned char const*)values;
+        for (size_t n = 0; n < sizeof values; ++n) {
+            hash = (hash ^ bytes[n]) * 0x100000001B3ull;
+        }
+    }
+    return hash;
+}
+
+// Returns false if a frame blocked on generation or meshing. With load_hash set, every frame waits for its chunk
+// jobs and integrates and uploads everything, and the chunks each frame ended up with are hashed into it.
+static bool run_flight(::render *render, ::cube_mesh_cache *cube_mesh_cache, ::chunk_draw_mode draw_mode,
+                       ::bench_flight flight, int frames, int frame_rate, ::input_replay *replay, uint64_t *load_hash = nullptr)
+{
+    static ::world world;
+    static ::job_system jobs;
+    static ::chunk_mesh_uploads uploads;
+    static ::world_visible_chunks visible;
+    static ::simulation simulation;
+    init_world(&world);
+    init_job_system(&jobs, 0);
+
+    render->camera = camera::init(45);
+    render->camera.set_aspect((float)BENCH_WIDTH/BENCH_HEIGHT);
+    if (flight == BENCH_FLIGHT_REPLAY) {
+        render->camera.position = replay->camera_position;
+        render->camera.yaw_pitch = replay->camera_yaw_pitch;
+        init_simulation(&simulation, &render->camera, replay->tick_rate);
+    }
+
+    double *frame_times = (double*)malloc(frames * sizeof *frame_times);
+    size_t draw_calls = 0, vertices = 0, loading_in_view = 0;
+    int blocked_frames = 0;
+    double budget = load_hash ? INFINITY : BENCH_STREAMING_BUDGET_MS / 1000.0;
+    if (load_hash) {
+        *load_hash = 0xCBF29CE484222325ull;
+    }
+
+    auto next_frame = std::chrono::steady_clock::now();
+    for (int frame = 0; frame < frames; ++frame) {
+        auto start = std::chrono::steady_clock::now();
+        uint64_t begin_ticks = read_profiler_clock();
+        {
+            PROFILE_ZONE("frame");
+
+            // Same order as frame() in the app
+            fly(&render->camera, flight, frame, replay, &simulation);
+            integrate_world_chunks(&world, budget);
+            change_world_chunk_offset_relative_to_camera(&world, &render->camera);
+            ::job_counter chunk_jobs = {};
+            ::job_counter *frame_jobs = load_hash ? &chunk_jobs : nullptr;
+            generate_world(&world, &jobs, &render->camera, frame_jobs);
+            update_world_meshes(&world, &uploads, &jobs, CHUNK_MESH_MODE_GREEDY, draw_mode == CHUNK_DRAW_MODE_INSTANCED, frame_jobs);
+            if (frame_jobs) {
+                wait_for_counter(&jobs, frame_jobs);
+            }
+            upload_world_meshes(render, &uploads, budget);
+
+            get_visible_world_chunks(&world, &render->camera.get_frustum(), &visible);
+
+            begin_render(render, BENCH_WIDTH, BENCH_HEIGHT);
+            switch (draw_mode) {
+                case CHUNK_DRAW_MODE_INSTANCED:
+                    draw_world_instanced(render, visible);
+                    break;
+                case CHUNK_DRAW_MODE_PER_VOXEL:
+                    draw_world_per_voxel(render, cube_mesh_cache, visible);
+                    break;
+                default:
+                    draw_world(render, visible);
+                    break;
+            }
+            end_render(render);
+        }
+        frame_times[frame] = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        blocked_frames += count_blocking_zones(begin_ticks) > 0;
+        draw_calls += render->stats.draw_calls;
+        vertices += render->stats.vertices;
+        loading_in_view += world.loading_in_view;
+        if (load_hash) {
+            *load_hash = hash_world_loads(*load_hash, &world);
+        }
+
+        // Leave the workers the rest of the frame, like vsync would
+        if (frame_rate > 0) {
+            next_frame += std::chrono::nanoseconds(1000000000 / frame_rate);
+            std::this_thread::sleep_until(next_frame);
+        }
+    }
+
+    deinit_job_system(&jobs);
+    deinit_chunk_mesh_uploads(&uploads);
+    size_t generated = world.generated_count;
+    deinit_world_meshes(&world);
+    deinit_world(&world);
+
+    std::sort(frame_times, frame_times + frames);
+    printf("Flight %s, %s: %d frames%s\n", bench_flight_names[flight], bench_draw_mode_names[draw_mode], frames, load_hash ? ", chunk jobs drained" : "");
+    printf("  Frame time (ms): p50 %.3f, p90 %.3f, p99 %.3f, max %.3f\n",
+        get_percentile(frame_times, frames, 50) * 1e3,
+        get_percentile(frame_times, frames, 90) * 1e3,
+        get_percentile(frame_times, frames, 99) * 1e3,
+        frame_times[frames-1] * 1e3);
+    printf("  Draw calls: %.1f per frame\n", (double)draw_calls / frames);
+    printf("  Vertices submitted: %.1f per frame\n", (double)vertices / frames);
+    printf("  Chunks generated: %zu\n", generated);
+    printf("  Chunks in view still loading: %.1f per frame\n", (double)loading_in_view / frames);
+    printf("  Frames blocked on generation or meshing: %d\n", blocked_frames);
+    free(frame_times);
+
+    if (blocked_frames > 0) {
+        fprintf(stderr, "Flight %s, %s: the main thread ran chunk jobs in %d frames\n", bench_flight_names[flight], bench_draw_mode_names[draw_mode], blocked_frames);
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    int frames = BENCH_DEFAULT_FRAMES;
+    int frame_rate = BENCH_DEFAULT_FRAME_RATE;
+    char const *trace_path = nullptr;
+    char const *replay_path = nullptr;
+    // CHUNK_DRAW_MODE_COUNT runs every mode
+    int draw_mode = CHUNK_DRAW_MODE_BAKED;
+    bool usage = false;
+    for (int i = 1; i < argc; i += 2) {
+        if (i+1 >= argc) {
+            usage = true;
+        } else if (strcmp(argv[i], "--frames") == 0) {
+            frames = atoi(argv[i+1]);
+        } else if (strcmp(argv[i], "--rate") == 0) {
+            frame_rate = atoi(argv[i+1]);
+        } else if (strcmp(argv[i], "--trace") == 0) {
+            trace_path = argv[i+1];
+        } else if (strcmp(argv[i], "--replay") == 0) {
+            replay_path = argv[i+1];
+        } else if (strcmp(argv[i], "--draw") == 0) {
+            draw_mode = -1;
+            for (int mode = 0; mode < CHUNK_DRAW_MODE_COUNT; ++mode) {
+                if (strcmp(argv[i+1], bench_draw_mode_names[mode]) == 0) {
+                    draw_mode = mode;
+                }
+            }
+            if (strcmp(argv[i+1], "all") == 0) {
+                draw_mode = CHUNK_DRAW_MODE_COUNT;
+            }
+            usage |= draw_mode < 0;
+        } else {
+            usage = true;
+        }
+    }
+    if (usage || frames <= 0) {
+        fprintf(stderr, "Usage: %s [--frames frames] [--rate frame rate] [--trace trace path] [--replay input recording]\n"
+                        "       [--draw baked|instanced|per-voxel|all]\n", argv[0]);
+        return 1;
+    }
+
+    ::input_replay replay = {};
+    if (replay_path && !load_input_replay(&replay, replay_path)) {
+        return 1;
+    }
+    // A recording stopped before its first frame has nothing to fly
+    int replay_frames = replay_path ? count_input_replay_frames(&replay) : 0;
+    if (replay_path && replay_frames == 0) {
+        fprintf(stderr, "Input replay: %s has no frames\n", replay_path);
+        unload_input_replay(&replay);
+        return 1;
+    }
+
+    set_profiler_thread_name("Main");
+    // Always on, the zones are how frames blocked on chunk jobs get caught
+    set_profiler_enabled(true);
+
+    sg_shader_desc shader_desc = get_dummy_shader_desc();
+    sg_shader_desc chunk_shader_desc = get_dummy_chunk_shader_desc();
+    sg_shader_desc voxel_shader_desc = get_dummy_voxel_shader_desc();
+    ::render render = init_render({}, &shader_desc, &chunk_shader_desc, &voxel_shader_desc);
+    ::cube_mesh_cache cube_mesh_cache = init_cube_mesh_cache(&render);
+
+    bool ok = true;
+    if (replay_path) {
+        // Flown twice with each frame's chunk jobs drained, both have to load the same chunks in the same frames
+        uint64_t load_hashes[2];
+        for (uint64_t &load_hash : load_hashes) {
+            ::input_replay drained_replay = replay;
+            ok &= run_flight(&render, &cube_mesh_cache, CHUNK_DRAW_MODE_BAKED, BENCH_FLIGHT_REPLAY, replay_frames, 0, &drained_replay, &load_hash);
+        }
+        if (load_hashes[0] != load_hashes[1]) {
+            fprintf(stderr, "Input replay: %s loads different chunks on two drained runs (%016llx, %016llx)\n", replay_path,
+                    (unsigned long long)load_hashes[0], (unsigned long long)load_hashes[1]);
+            ok = false;
+        } else {
+            printf("Input replay: chunk loads match on two drained runs (%016llx)\n", (unsigned long long)load_hashes[0]);
+        }
+    }
+
+    int first_draw_mode = draw_mode == CHUNK_DRAW_MODE_COUNT ? 0 : draw_mode;
+    int last_draw_mode = draw_mode == CHUNK_DRAW_MODE_COUNT ? CHUNK_DRAW_MODE_COUNT-1 : draw_mode;
+    for (int mode = first_draw_mode; mode <= last_draw_mode; ++mode) {
+        if (replay_path) {
+            // Every mode flies the recording from its start
+            ::input_replay mode_replay = replay;
+            ok &= run_flight(&render, &cube_mesh_cache, (::chunk_draw_mode)mode, BENCH_FLIGHT_REPLAY, replay_frames, frame_rate, &mode_replay);
+        } else {
+            for (int flight = 0; flight < BENCH_FLIGHT_REPLAY; ++flight) {
+                ok &= run_flight(&render, &cube_mesh_cache, (::chunk_draw_mode)mode, (::bench_flight)flight, frames, frame_rate, nullptr);
+            }
+        }
+    }
+    unload_input_replay(&replay);
+    uninit_cube_mesh_cache(&cube_mesh_cache);
+
+    sg_shutdown();
+
+    if (trace_path) {
+        if (!write_profiler_trace(trace_path)) {
+            return 1;
+        }
+        printf("Trace written to %s\n", trace_path);
+    }
+    deinit_profiler();
+    return ok ? 0 : 1;
+}
@@ -15,6 +15,61 @@ void main() {
 }
 @end
 
+// Baked chunk meshes, 8 byte vertices relative to the chunk (chunk_vertex in chunk_mesh.h)
+@vs chunk_vs
+// xyz: corner of the face within the chunk, w: the cube_side it looks at
+in vec4 packed_position;
+// xy: uv, zw: unused for now
+in vec4 packed_uv;
+out vec2 fs_uv;
+out vec3 fs_normal;
+uniform chunk_vs_params {
+    // View projection around the camera, the camera position is in chunk_offset instead
+    mat4 vp;
+    // Chunk origin relative to the camera, so positions stay small far from the world origin
+    vec4 chunk_offset;
+};
+
+void main() {
+    // Blocks are centered on their position, corners are half a block off
+    vec3 position = packed_position.xyz - 0.5 + chunk_offset.xyz;
+    gl_Position = vp * vec4(position, 1.0);
+    fs_uv = packed_uv.xy;
+
+    // Same normals as cube_vertices in mesh.cpp
+    float side = packed_position.w;
+    vec3 axis = vec3(step(side, 1.5), step(1.5, side)*step(side, 3.5), step(3.5, side));
+    fs_normal = axis * (1.0 - 2.0*mod(side, 2.0)) * vec3(1.0, 1.0, -1.0);
+}
+@end
+
+// Instanced blocks, the cube quads of cube_vertices drawn once per chunk_instance (chunk_mesh.h)
+@vs voxel_vs
+in vec3 position;
+in vec3 normal;
+in vec2 uv;
+// xyz: block within the chunk, w: its visible sides (cube_side_flags)
+in vec4 instance;
+out vec2 fs_uv;
+out vec3 fs_normal;
+uniform voxel_vs_params {
+    // Same as in chunk_vs_params
+    mat4 vp;
+    vec4 chunk_offset;
+    // x: the cube side flag of the quad being drawn
+    vec4 side;
+};
+
+void main() {
+    // Blocks that do not show this side collapse to a point outside the clip volume
+    float visible = step(0.5, mod(floor(instance.w / side.x), 2.0));
+    vec4 clip = vp * vec4(position + instance.xyz + chunk_offset.xyz, 1.0);
+    gl_Position = mix(vec4(2.0, 2.0, 2.0, 1.0), clip, visible);
+    fs_uv = uv;
+    fs_normal = normal;
+}
+@end
+
 @fs fs
 in vec2 fs_uv;
 in vec3 fs_normal;
@@ -24,7 +79,9 @@ const float ambient = 0.5;
 const vec3 light = vec3(0.1, 1.0, 0.3);
 
 void main() {
-    vec3 color = (fs_uv.y+fs_uv.x+fs_normal)/4.0+vec3(0.5, 0.5, 0.5);
+    // Merged faces have uvs going past 1, repeat them once per block
+    vec2 uv = fract(fs_uv);
+    vec3 color = (uv.y+uv.x+fs_normal)/4.0+vec3(0.5, 0.5, 0.5);
     float factor = max(dot(fs_normal, normalize(light)), 0.0);
     factor += 0.7;
     factor *= smoothstep(0.3, 1, gl_FragCoord.w*fog_distance);
@@ -33,4 +90,6 @@ void main() {
 }
 @end
 
-@program cube vs fs
\ No newline at end of file
+@program cube vs fs
+@program chunk chunk_vs fs
+@program voxel voxel_vs fs
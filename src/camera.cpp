@@ -1,32 +1,74 @@
 #include "camera.h"
 #include "lib/imgui/imgui.h"
+#include "profiler.h"
+
+#define CAMERA_NEAR 0.1f
+#define CAMERA_FAR 1000.0f
 
 static hmm_mat4 rotation_matrix(camera *camera)
 {
     return HMM_Rotate(camera->yaw_pitch.Y, {0.0, 1.0, 0.0}) * HMM_Rotate(camera->yaw_pitch.X, {1.0, 0.0, 0.0});
 }
 
-static hmm_mat4 make_vp(camera *camera)
+// The view is a rotation and a translation, so its inverse is the transposed rotation and the translation rotated back
+static hmm_mat4 inverse_view(hmm_mat4 const &view)
 {
-    hmm_vec4 eye = rotation_matrix(camera) * hmm_vec4{0.0f, 0.0f, 1.0f, 1.0f};
-    hmm_mat4 view = HMM_LookAt(camera->position, camera->position + eye.XYZ, {0.0f, 1.0f, 0.0f});
-    hmm_mat4 proj = HMM_Perspective(camera->fov_deg, camera->aspect, 0.1f, 1000.0f);
+    hmm_mat4 result = HMM_Mat4d(1);
+    for (int col = 0; col < 3; ++col) {
+        for (int row = 0; row < 3; ++row) {
+            result.Elements[col][row] = view.Elements[row][col];
+        }
+    }
+    for (int row = 0; row < 3; ++row) {
+        result.Elements[3][row] = -(view.Elements[row][0]*view.Elements[3][0] + view.Elements[row][1]*view.Elements[3][1] + view.Elements[row][2]*view.Elements[3][2]);
+    }
+    return result;
+}
+
+// Inverse of HMM_Perspective, x and y only scale, z and w mix in a 2x2 block
+static hmm_mat4 inverse_projection(hmm_mat4 const &projection)
+{
+    hmm_mat4 result = {};
+    float a = projection.Elements[2][2];
+    float b = projection.Elements[3][2];
+    result.Elements[0][0] = 1/projection.Elements[0][0];
+    result.Elements[1][1] = 1/projection.Elements[1][1];
+    result.Elements[3][2] = -1;
+    result.Elements[2][3] = 1/b;
+    result.Elements[3][3] = a/b;
+    return result;
+}
+
+static void update_camera(camera *camera)
+{
+    if (!camera->dirty) {
+        return;
+    }
+    PROFILE_FUNCTION();
 
-    return proj * view;
+    hmm_vec4 eye = rotation_matrix(camera) * hmm_vec4{0.0f, 0.0f, 1.0f, 1.0f};
+    camera->view = HMM_LookAt(camera->position, camera->position + eye.XYZ, {0.0f, 1.0f, 0.0f});
+    camera->projection = HMM_Perspective(camera->fov_deg, camera->aspect, CAMERA_NEAR, CAMERA_FAR);
+    camera->vp = camera->projection * camera->view;
+    camera->inverse_vp = inverse_view(camera->view) * inverse_projection(camera->projection);
+    camera->frustum = get_frustum(camera->vp);
+    camera->dirty = false;
 }
 
 camera camera::init(float fov_deg)
 {
     camera result = {};
     result.fov_deg = fov_deg;
-    result.vp = make_vp(&result);
+    result.dirty = true;
     return result;
 }
 
 void camera::set_aspect(float aspect)
 {
-    this->aspect = aspect;
-    this->vp = make_vp(this);
+    if (this->aspect != aspect) {
+        this->aspect = aspect;
+        this->dirty = true;
+    }
 }
 
 void camera::rotate(hmm_vec2 by)
@@ -45,16 +87,46 @@ void camera::rotate(hmm_vec2 by)
         this->yaw_pitch.X = -89.9;
     }
 
-    this->vp = make_vp(this);
+    this->dirty = true;
 }
 
 void camera::move(float forward, float sideways, float upward)
 {
     this->position += (HMM_Rotate(this->yaw_pitch.Y, {0.0, 1.0, 0.0}) * hmm_vec4{sideways, upward, forward}).XYZ;
-    this->vp = make_vp(this);
+    this->dirty = true;
 }
 
-hmm_mat4 camera::get_vp() const
+hmm_vec3 camera::get_direction()
 {
+    return (rotation_matrix(this) * hmm_vec4{0.0f, 0.0f, 1.0f, 0.0f}).XYZ;
+}
+
+hmm_mat4 camera::get_view()
+{
+    update_camera(this);
+    return this->view;
+}
+
+hmm_mat4 camera::get_projection()
+{
+    update_camera(this);
+    return this->projection;
+}
+
+hmm_mat4 camera::get_vp()
+{
+    update_camera(this);
     return this->vp;
-}
\ No newline at end of file
+}
+
+hmm_mat4 camera::get_inverse_vp()
+{
+    update_camera(this);
+    return this->inverse_vp;
+}
+
+::frustum const &camera::get_frustum()
+{
+    update_camera(this);
+    return this->frustum;
+}
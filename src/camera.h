@@ -2,20 +2,37 @@
 #define CT_CAMERA_H
 
 #include "lib/HandmadeMath.h"
+#include "frustum.h"
 
 struct camera {
     float fov_deg;
     float aspect;
     hmm_vec3 position;
     hmm_vec2 yaw_pitch;
+
+    // Everything below is derived from the fields above, and only rebuilt on the first get_* after they change.
+    // Set dirty after changing the fields directly.
+    bool dirty;
+    hmm_mat4 view;
+    hmm_mat4 projection;
     hmm_mat4 vp;
+    hmm_mat4 inverse_vp;
+    ::frustum frustum;
 
     static camera init(float fov_deg);
     void set_aspect(float aspect);
     void rotate(hmm_vec2 by);
     void move(float forward, float sideways, float upward);
+    // Where the camera looks, a unit vector
+    hmm_vec3 get_direction();
 
-    hmm_mat4 get_vp() const;
+    hmm_mat4 get_view();
+    hmm_mat4 get_projection();
+    hmm_mat4 get_vp();
+    // Clip space back to world space
+    hmm_mat4 get_inverse_vp();
+    // The planes of get_vp(), for culling
+    ::frustum const &get_frustum();
 };
 
-#endif
\ No newline at end of file
+#endif
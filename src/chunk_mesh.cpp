@@ -0,0 +1,346 @@
+#include "chunk_mesh.h"
+#include "profiler.h"
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+// The quad of a side in cube_vertices, turned into chunk_vertex corners
+struct chunk_quad_template {
+    // 1 where the vertex is on the positive side of the block
+    uint8_t corners[4][3];
+    uint8_t uvs[4][2];
+    // The position axis each uv component follows, so uvs repeat once per block on merged faces
+    int uv_axes[2];
+};
+
+static const chunk_mesh_index chunk_quad_indices[6] = {0, 1, 2, 0, 2, 3};
+
+// Finds the order to put the vertices of a cube quad in, so chunk_quad_indices draws the same triangles with the same winding
+static void get_quad_vertex_order(size_t quad_no, int order[4])
+{
+    int indices[6];
+    for (size_t i = 0; i < 6; ++i) {
+        indices[i] = cube_indices[quad_no*6 + i] - quad_no*4;
+    }
+
+    // The first triangle becomes (0, 1, 2) when started at the right vertex, the second has to be (0, 2, 3) then
+    for (int r = 0; r < 3; ++r) {
+        int a = indices[r], b = indices[(r+1)%3], c = indices[(r+2)%3];
+        int d = 0+1+2+3 - a - b - c;
+        for (int s = 0; s < 3; ++s) {
+            if (indices[3+s] == a && indices[3+(s+1)%3] == c && indices[3+(s+2)%3] == d) {
+                order[0] = a;
+                order[1] = b;
+                order[2] = c;
+                order[3] = d;
+                return;
+            }
+        }
+    }
+    assert(false && "Cube quad triangles do not share a diagonal");
+}
+
+static ::chunk_quad_template make_chunk_quad_template(int side)
+{
+    ::chunk_quad_template output = {};
+    size_t quad_no = get_cube_side_quad_no(1 << side);
+    float const *input = cube_vertices + quad_no*4*8;
+    int order[4];
+    get_quad_vertex_order(quad_no, order);
+
+    for (size_t i = 0; i < 4; ++i) {
+        float const *vertex = input + order[i]*8;
+        for (int a = 0; a < 3; ++a) {
+            output.corners[i][a] = vertex[a] > 0;
+        }
+        for (int c = 0; c < 2; ++c) {
+            output.uvs[i][c] = vertex[6 + c] > 0.5f;
+        }
+    }
+
+    for (int c = 0; c < 2; ++c) {
+        output.uv_axes[c] = -1;
+        for (int a = 0; a < 3 && output.uv_axes[c] < 0; ++a) {
+            bool same = true, inverted = true;
+            for (size_t i = 0; i < 4; ++i) {
+                same = same && output.corners[i][a] == output.uvs[i][c];
+                inverted = inverted && output.corners[i][a] != output.uvs[i][c];
+            }
+            if (same || inverted) {
+                output.uv_axes[c] = a;
+            }
+        }
+    }
+    return output;
+}
+
+static ::chunk_quad_template const *get_chunk_quad_template(int side)
+{
+    static ::chunk_quad_template templates[CUBE_SIDE_COUNT];
+    static bool initialized = [] {
+        for (int side = 0; side < CUBE_SIDE_COUNT; ++side) {
+            templates[side] = make_chunk_quad_template(side);
+        }
+        return true;
+    }();
+    (void)initialized;
+    return &templates[side];
+}
+
+// Appends the face of a side covering a rectangle of blocks, size is 1 along the side's axis
+static void append_chunk_quad(::chunk_mesh_buffer *buffer, int side, int const offset[3], int const size[3])
+{
+    ::chunk_quad_template const *quad = get_chunk_quad_template(side);
+    ::chunk_vertex *vertices = buffer->vertices + buffer->vertex_count;
+
+    for (size_t i = 0; i < 4; ++i) {
+        ::chunk_vertex *vertex = &vertices[i];
+        vertex->x = offset[0] + quad->corners[i][0]*size[0];
+        vertex->y = offset[1] + quad->corners[i][1]*size[1];
+        vertex->z = offset[2] + quad->corners[i][2]*size[2];
+        vertex->side = side;
+        vertex->u = quad->uvs[i][0] * (quad->uv_axes[0] >= 0 ? size[quad->uv_axes[0]] : 1);
+        vertex->v = quad->uvs[i][1] * (quad->uv_axes[1] >= 0 ? size[quad->uv_axes[1]] : 1);
+        vertex->ao = 0;
+        vertex->material = 0;
+    }
+
+    buffer->vertex_count += 4;
+}
+
+::chunk_mesh_buffer init_chunk_mesh_buffer(size_t quad_count)
+{
+    ::chunk_mesh_buffer output = {};
+    output.vertices = (::chunk_vertex*)malloc(quad_count*4 * sizeof *output.vertices);
+    return output;
+}
+
+void deinit_chunk_mesh_buffer(::chunk_mesh_buffer *buffer)
+{
+    free(buffer->vertices);
+    *buffer = {};
+}
+
+void get_chunk_mesh_quad_indices(chunk_mesh_index *indices)
+{
+    for (size_t quad = 0; quad < CHUNK_MESH_MAX_QUADS; ++quad) {
+        for (size_t i = 0; i < 6; ++i) {
+            indices[quad*6 + i] = quad*4 + chunk_quad_indices[i];
+        }
+    }
+}
+
+size_t build_chunk_instances(chunk_mesh_map const &mesh_map, ::chunk_instance *output)
+{
+    size_t count = 0;
+    for (int x = 0; x < CHUNK_SIZE; ++x) {
+        for (int z = 0; z < CHUNK_SIZE; ++z) {
+            chunk_column visible = 0;
+            for (int side = 0; side < CUBE_SIDE_COUNT; ++side) {
+                visible |= mesh_map[side][x][z];
+            }
+
+            while (visible) {
+                int y = __builtin_ctz(visible);
+                visible &= visible - 1;
+                if (output) {
+                    output[count] = {(uint8_t)x, (uint8_t)y, (uint8_t)z, get_mesh_map_side_flags(mesh_map, x, y, z)};
+                }
+                count++;
+            }
+        }
+    }
+    return count;
+}
+
+size_t count_chunk_mesh_quads(chunk_mesh_map const &mesh_map)
+{
+    size_t count = 0;
+
+    for (int side = 0; side < CUBE_SIDE_COUNT; ++side) {
+        for (int x = 0; x < CHUNK_SIZE; ++x) {
+            for (int z = 0; z < CHUNK_SIZE; ++z) {
+                count += __builtin_popcount(mesh_map[side][x][z]);
+            }
+        }
+    }
+
+    if (count > CHUNK_MESH_MAX_QUADS) {
+        fprintf(stderr, "Chunk mesh: %zu quads is more than a chunk can have, clipping\n", count);
+        count = CHUNK_MESH_MAX_QUADS;
+    }
+
+    return count;
+}
+
+// Closes the quad range of every side up to and including side
+static void end_chunk_mesh_side(::chunk_mesh_buffer *buffer, int side)
+{
+    for (int i = side + 1; i <= CUBE_SIDE_COUNT; ++i) {
+        buffer->side_offsets[i] = buffer->vertex_count/4;
+    }
+}
+
+void bake_chunk_mesh(chunk_mesh_map const &mesh_map, ::chunk_mesh_buffer *buffer)
+{
+    buffer->side_offsets[0] = buffer->vertex_count/4;
+    for (int side = 0; side < CUBE_SIDE_COUNT; ++side) {
+        for (int x = 0; x < CHUNK_SIZE; ++x) {
+            for (int z = 0; z < CHUNK_SIZE; ++z) {
+                chunk_column visible = mesh_map[side][x][z];
+
+                while (visible) {
+                    int y = __builtin_ctz(visible);
+                    visible &= visible - 1;
+
+                    if (buffer->vertex_count/4 >= CHUNK_MESH_MAX_QUADS) {
+                        end_chunk_mesh_side(buffer, side);
+                        return;
+                    }
+                    const int offset[3] = {x, y, z}, size[3] = {1, 1, 1};
+                    append_chunk_quad(buffer, side, offset, size);
+                }
+            }
+        }
+        end_chunk_mesh_side(buffer, side);
+    }
+}
+
+// Transposes a square of columns, bit i of columns[j] ends up in bit j of columns[i]
+static void transpose_chunk_columns(chunk_column columns[CHUNK_SIZE])
+{
+    chunk_column mask = 0x0000FFFF;
+    for (int width = CHUNK_SIZE/2; width > 0; width >>= 1, mask ^= mask << width) {
+        for (int k = 0; k < CHUNK_SIZE; k = ((k | width) + 1) & ~width) {
+            chunk_column swap = ((columns[k] >> width) ^ columns[k | width]) & mask;
+            columns[k] ^= swap << width;
+            columns[k | width] ^= swap;
+        }
+    }
+}
+
+void bake_chunk_mesh_greedy(chunk_mesh_map const &mesh_map, ::chunk_mesh_buffer *buffer)
+{
+    static_assert(CHUNK_SIZE == 32, "Columns are transposed as 32x32 bit squares");
+    //       slice       row
+    chunk_column planes[CHUNK_SIZE][CHUNK_SIZE];
+
+    // Sides go in get_side_flags neighbour order (+x, -x, +y, -y, +z, -z)
+    buffer->side_offsets[0] = buffer->vertex_count/4;
+    for (int side = 0; side < CUBE_SIDE_COUNT; ++side) {
+        // n is the axis the faces point along, the bits of a row go along bit_axis, rows along row_axis
+        const int n = side / 2;
+        int bit_axis, row_axis;
+        if (n == 1) {
+            // Columns go along y, turn them into rows along z for each y
+            bit_axis = 2;
+            row_axis = 0;
+            for (int x = 0; x < CHUNK_SIZE; ++x) {
+                chunk_column columns[CHUNK_SIZE];
+                memcpy(columns, mesh_map[side][x], sizeof columns);
+                transpose_chunk_columns(columns);
+                for (int y = 0; y < CHUNK_SIZE; ++y) {
+                    planes[y][x] = columns[y];
+                }
+            }
+        } else {
+            // Columns already are rows along y, slices are x or z
+            bit_axis = 1;
+            row_axis = n == 0 ? 2 : 0;
+            for (int x = 0; x < CHUNK_SIZE; ++x) {
+                for (int z = 0; z < CHUNK_SIZE; ++z) {
+                    planes[n == 0 ? x : z][n == 0 ? z : x] = mesh_map[side][x][z];
+                }
+            }
+        }
+
+        for (int s = 0; s < CHUNK_SIZE; ++s) {
+            chunk_column *rows = planes[s];
+            for (int row = 0; row < CHUNK_SIZE; ++row) {
+                while (rows[row]) {
+                    // Take the first run of set bits in the row, then grow it over the rows after while they have it all
+                    int start = __builtin_ctz(rows[row]);
+                    chunk_column run = rows[row] >> start;
+                    int width = ~run ? __builtin_ctz(~run) : CHUNK_SIZE;
+                    chunk_column mask = (width < CHUNK_SIZE ? (chunk_column(1) << width) - 1 : ~chunk_column(0)) << start;
+
+                    int height = 1;
+                    while (row + height < CHUNK_SIZE && (rows[row + height] & mask) == mask) {
+                        rows[row + height] &= ~mask;
+                        height++;
+                    }
+                    rows[row] &= ~mask;
+
+                    if (buffer->vertex_count/4 >= CHUNK_MESH_MAX_QUADS) {
+                        end_chunk_mesh_side(buffer, side);
+                        return;
+                    }
+
+                    int offset[3], size[3] = {1, 1, 1};
+                    offset[n] = s;
+                    offset[bit_axis] = start;
+                    offset[row_axis] = row;
+                    size[bit_axis] = width;
+                    size[row_axis] = height;
+                    append_chunk_quad(buffer, side, offset, size);
+                }
+            }
+        }
+        end_chunk_mesh_side(buffer, side);
+    }
+}
+
+static void run_chunk_mesh_job(void *context, void *data)
+{
+    PROFILE_FUNCTION();
+    ::job_result_list *results = (::job_result_list*)context;
+    ::chunk_mesh_job *job = (::chunk_mesh_job*)data;
+
+    job->buffer = {};
+    job->instances = nullptr;
+    job->instance_count = 0;
+    if (job->instanced) {
+        job->instance_count = build_chunk_instances(job->mesh_map, nullptr);
+        if (job->instance_count > 0) {
+            job->instances = (::chunk_instance*)malloc(job->instance_count * sizeof *job->instances);
+            build_chunk_instances(job->mesh_map, job->instances);
+        }
+        push_job_result(results, &job->node);
+        return;
+    }
+
+    size_t quad_count = count_chunk_mesh_quads(job->mesh_map);
+    if (quad_count > 0) {
+        job->buffer = init_chunk_mesh_buffer(quad_count);
+        if (job->mode == CHUNK_MESH_MODE_GREEDY) {
+            bake_chunk_mesh_greedy(job->mesh_map, &job->buffer);
+        } else {
+            bake_chunk_mesh(job->mesh_map, &job->buffer);
+        }
+    }
+
+    push_job_result(results, &job->node);
+}
+
+void submit_chunk_mesh_job(::job_system *jobs, ::job_result_list *results, ::chunk *chunk, ::chunk_mesh_mode mode, bool instanced,
+                           ::job_counter *counter)
+{
+    ::chunk_mesh_job *job = (::chunk_mesh_job*)malloc(sizeof *job);
+    job->chunk = chunk;
+    job->mesh_version = chunk->mesh_version;
+    job->mode = mode;
+    job->instanced = instanced;
+    memcpy(job->mesh_map, chunk->mesh_map, sizeof job->mesh_map);
+
+    submit_job(jobs, {run_chunk_mesh_job, results, job}, counter);
+}
+
+void free_chunk_mesh_job(::chunk_mesh_job *job)
+{
+    if (job->buffer.vertices) {
+        deinit_chunk_mesh_buffer(&job->buffer);
+    }
+    free(job->instances);
+    free(job);
+}
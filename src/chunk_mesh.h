@@ -0,0 +1,131 @@
+#ifndef CT_CHUNK_MESH_H
+#define CT_CHUNK_MESH_H
+
+#include "mesh.h"
+#include "world.h"
+
+// Most faces a chunk can show: every face between two blocks inside it, and every face on its border
+#define CHUNK_MESH_MAX_QUADS (CHUNK_SIZE*CHUNK_SIZE*(3*CHUNK_SIZE+3))
+
+// Every chunk mesh is drawn with the same quad indices, big enough for the densest chunk
+#if CHUNK_MESH_MAX_QUADS*4 > 65536
+typedef uint32_t chunk_mesh_index;
+#define CHUNK_MESH_INDEX_TYPE SG_INDEXTYPE_UINT32
+#else
+typedef uint16_t chunk_mesh_index;
+#define CHUNK_MESH_INDEX_TYPE SG_INDEXTYPE_UINT16
+#endif
+
+// Vertex of a baked chunk mesh, decoded by chunk_vs in res/shaders.glsl
+struct chunk_vertex {
+    // Corner of the face relative to the chunk origin, from 0 to CHUNK_SIZE
+    uint8_t x, y, z;
+    // The cube_side the face looks at
+    uint8_t side;
+    // Repeats once per block, so up to CHUNK_SIZE on merged faces
+    uint8_t u, v;
+    // Unused for now, room for ambient occlusion and materials
+    uint8_t ao, material;
+};
+
+static_assert(sizeof(chunk_vertex) == 8, "Chunk vertices are uploaded as two UBYTE4 attributes");
+static_assert(CHUNK_SIZE < 256, "Chunk vertex positions are 8 bits");
+
+// Quads of 4 vertices each, in the order get_chunk_mesh_quad_indices draws them in.
+// Quads are grouped by the cube_side they look at, so sides facing away from the camera can be skipped.
+struct chunk_mesh_buffer {
+    ::chunk_vertex *vertices;
+    size_t vertex_count;
+    // First quad of each cube_side, the last one is the quad count
+    size_t side_offsets[CUBE_SIDE_COUNT + 1];
+};
+
+::chunk_mesh_buffer init_chunk_mesh_buffer(size_t quad_count);
+void deinit_chunk_mesh_buffer(::chunk_mesh_buffer *buffer);
+
+// Fills in the indices shared by all chunk meshes (0, 1, 2, 0, 2, 3 for each quad), CHUNK_MESH_MAX_QUADS*6 of them
+void get_chunk_mesh_quad_indices(chunk_mesh_index *indices);
+
+// A block with visible faces, drawn as an instance of the cube quads
+struct chunk_instance {
+    // Block within the chunk
+    uint8_t x, y, z;
+    cube_side_flags sides;
+};
+
+static_assert(sizeof(chunk_instance) == 4, "Chunk instances are uploaded as one UBYTE4 attribute");
+
+enum chunk_mesh_mode {
+    CHUNK_MESH_MODE_PER_FACE,
+    CHUNK_MESH_MODE_GREEDY,
+    CHUNK_MESH_MODE_COUNT
+};
+
+/**
+ * @brief      Counts the visible quads of a chunk, based on its mesh map.
+ *
+ * @param[in]  mesh_map  The mesh map of the chunk
+ *
+ * @return     Number of quads bake_chunk_mesh will output
+ */
+size_t count_chunk_mesh_quads(chunk_mesh_map const &mesh_map);
+
+/**
+ * @brief      Bakes every visible face of a chunk into one buffer, one cube_side after another.
+ *             Vertex positions are relative to the chunk origin.
+ *
+ * @param[in]  mesh_map  The mesh map of the chunk
+ * @param      buffer    The output buffer, must have space for count_chunk_mesh_quads quads
+ */
+void bake_chunk_mesh(chunk_mesh_map const &mesh_map, ::chunk_mesh_buffer *buffer);
+
+/**
+ * @brief      Bakes the visible faces of a chunk, merging coplanar neighbouring faces
+ *             into as large rectangles as possible. Covers the same faces as bake_chunk_mesh.
+ *
+ * @param[in]  mesh_map  The mesh map of the chunk
+ * @param      buffer    The output buffer, count_chunk_mesh_quads quads is always enough
+ */
+void bake_chunk_mesh_greedy(chunk_mesh_map const &mesh_map, ::chunk_mesh_buffer *buffer);
+
+/**
+ * @brief      Lists the blocks of a chunk that have visible faces, in column order.
+ *
+ * @param[in]  mesh_map  The mesh map of the chunk
+ * @param      output    Where the instances go, nullptr to only count them
+ *
+ * @return     The number of instances
+ */
+size_t build_chunk_instances(chunk_mesh_map const &mesh_map, ::chunk_instance *output);
+
+// A chunk mesh baked on a worker, from a copy of the mesh map
+struct chunk_mesh_job {
+    ::job_node node; // has to be first
+    ::chunk *chunk;
+    // The mesh is only current if this still matches chunk->mesh_version
+    uint32_t mesh_version;
+    ::chunk_mesh_mode mode;
+    // Builds instances instead of a mesh, mode is ignored then
+    bool instanced;
+    chunk_mesh_map mesh_map;
+    // Empty when the chunk has no visible faces
+    ::chunk_mesh_buffer buffer;
+    ::chunk_instance *instances;
+    size_t instance_count;
+};
+
+/**
+ * @brief      Queues baking of a chunk mesh on the workers. Call from the main thread.
+ *
+ * @param      jobs     The job system
+ * @param      results  Where the finished chunk_mesh_job is pushed to
+ * @param      chunk    The chunk, with an up to date mesh map
+ * @param[in]  mode       The meshing mode
+ * @param[in]  instanced  Build instances for draw_world_instanced instead of a mesh
+ * @param      counter    Counts the job until it finished, can be null
+ */
+void submit_chunk_mesh_job(::job_system *jobs, ::job_result_list *results, ::chunk *chunk, ::chunk_mesh_mode mode, bool instanced,
+                           ::job_counter *counter = nullptr);
+void free_chunk_mesh_job(::chunk_mesh_job *job);
+
+#endif
@@ -0,0 +1,130 @@
+#include "chunk_pool.h"
+#include "world.h"
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define CHUNK_POOL_MMAP
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#define HUGE_PAGE_SIZE (2*1024*1024)
+
+static size_t round_up(size_t value, size_t to)
+{
+    return (value + to - 1) / to * to;
+}
+
+static void *map_slab(size_t *size, bool *huge_pages)
+{
+#ifdef CHUNK_POOL_MMAP
+    void *slab = MAP_FAILED;
+#ifdef MAP_HUGETLB
+    if (*huge_pages) {
+        size_t huge_size = round_up(*size, HUGE_PAGE_SIZE);
+        slab = mmap(nullptr, huge_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (slab != MAP_FAILED) {
+            *size = huge_size;
+            return slab;
+        }
+    }
+#endif
+    *size = round_up(*size, sysconf(_SC_PAGESIZE));
+    slab = mmap(nullptr, *size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (slab == MAP_FAILED) {
+        return nullptr;
+    }
+#ifdef MADV_HUGEPAGE
+    // No reserved huge pages, let the kernel back the slab with transparent ones if it can
+    *huge_pages = *huge_pages && madvise(slab, *size, MADV_HUGEPAGE) == 0;
+#else
+    *huge_pages = false;
+#endif
+    return slab;
+#else
+    *huge_pages = false;
+    *size = round_up(*size, 4096);
+#ifdef _MSC_VER
+    void *slab = _aligned_malloc(*size, 4096);
+#else
+    void *slab = aligned_alloc(4096, *size);
+#endif
+    if (slab) {
+        memset(slab, 0, *size);
+    }
+    return slab;
+#endif
+}
+
+static void unmap_slab(void *slab, size_t size)
+{
+#ifdef CHUNK_POOL_MMAP
+    munmap(slab, size);
+#elif defined(_MSC_VER)
+    _aligned_free(slab);
+#else
+    free(slab);
+#endif
+}
+
+::chunk_pool init_chunk_pool(size_t capacity, bool huge_pages)
+{
+    ::chunk_pool pool = {};
+    pool.slab_size = capacity * sizeof(::chunk);
+    pool.huge_pages = huge_pages;
+    pool.slots = (::chunk*)map_slab(&pool.slab_size, &pool.huge_pages);
+    if (pool.slots == nullptr) {
+        fprintf(stderr, "Chunk pool: failed to map %zu bytes\n", pool.slab_size);
+        return {};
+    }
+
+    pool.capacity = capacity;
+    pool.free_slots = (uint32_t*)malloc(capacity * sizeof *pool.free_slots);
+    // Hand out low slots first
+    for (size_t i = 0; i < capacity; ++i) {
+        pool.free_slots[i] = capacity - 1 - i;
+    }
+    pool.free_count = capacity;
+
+    printf("Chunk pool: %zu chunks, %zu KiB%s\n", capacity, pool.slab_size / 1024, pool.huge_pages ? ", huge pages" : "");
+    return pool;
+}
+
+void deinit_chunk_pool(::chunk_pool *pool)
+{
+    if (pool->slots) {
+        unmap_slab(pool->slots, pool->slab_size);
+    }
+    free(pool->free_slots);
+    *pool = {};
+}
+
+::chunk* acquire_chunk(::chunk_pool *pool)
+{
+    if (pool->free_count == 0) {
+        return nullptr;
+    }
+
+    ::chunk *chunk = &pool->slots[pool->free_slots[--pool->free_count]];
+
+    size_t occupancy = get_chunk_pool_occupancy(pool);
+    if (occupancy > pool->high_water_mark) {
+        pool->high_water_mark = occupancy;
+    }
+    return chunk;
+}
+
+void release_chunk(::chunk_pool *pool, ::chunk *chunk)
+{
+    assert(chunk >= pool->slots && chunk < pool->slots + pool->capacity);
+    assert(pool->free_count < pool->capacity);
+    pool->free_slots[pool->free_count++] = chunk - pool->slots;
+}
+
+size_t get_chunk_pool_occupancy(::chunk_pool const *pool)
+{
+    return pool->capacity - pool->free_count;
+}
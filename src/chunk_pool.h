@@ -0,0 +1,42 @@
+#ifndef CT_CHUNK_POOL_H
+#define CT_CHUNK_POOL_H
+
+#include <cstddef>
+#include <cstdint>
+
+struct chunk;
+
+// Fixed number of chunks in one contiguous, page aligned slab
+struct chunk_pool {
+    ::chunk *slots;
+    size_t capacity;
+    // Bytes mapped for the slab, rounded up to the page size
+    size_t slab_size;
+    bool huge_pages;
+
+    // Stack of free slot indices
+    uint32_t *free_slots;
+    size_t free_count;
+
+    // Stats
+    size_t high_water_mark;
+};
+
+/**
+ * @brief      Maps the slab for a chunk pool, all slots start out zeroed and free.
+ *
+ * @param[in]  capacity    The number of chunks
+ * @param[in]  huge_pages  Try to back the slab with huge pages, falls back to regular pages
+ *
+ * @return     The pool
+ */
+::chunk_pool init_chunk_pool(size_t capacity, bool huge_pages);
+void deinit_chunk_pool(::chunk_pool *pool);
+
+// Returns nullptr when every slot is taken
+::chunk* acquire_chunk(::chunk_pool *pool);
+void release_chunk(::chunk_pool *pool, ::chunk *chunk);
+
+size_t get_chunk_pool_occupancy(::chunk_pool const *pool);
+
+#endif
@@ -0,0 +1,60 @@
+#include "cpu_isa.h"
+
+const char *cpu_isa_names[CPU_ISA_COUNT] = {"Scalar", "SSE2", "SSE4.2", "AVX", "AVX2"};
+
+bool cpu_isa_supported(::cpu_isa isa)
+{
+#ifdef CPU_ISA_X86
+    // Might run before the runtime initialized the CPU model, e.g. from a static initializer
+    __builtin_cpu_init();
+#endif
+    switch (isa) {
+        case CPU_ISA_SCALAR:
+            return true;
+#ifdef CPU_ISA_X86
+        case CPU_ISA_SSE2:
+            return __builtin_cpu_supports("sse2");
+        case CPU_ISA_SSE42:
+            return __builtin_cpu_supports("sse4.2");
+        case CPU_ISA_AVX:
+            return __builtin_cpu_supports("avx");
+        case CPU_ISA_AVX2:
+            return __builtin_cpu_supports("avx2");
+#endif
+        default:
+            return false;
+    }
+}
+
+bool cpu_isa_kernel_supported(::cpu_isa_kernels const *kernels, ::cpu_isa isa)
+{
+    return isa >= 0 && isa < CPU_ISA_COUNT && (kernels->available & CPU_ISA_BIT(isa)) && cpu_isa_supported(isa);
+}
+
+::cpu_isa get_best_cpu_isa(::cpu_isa_kernels const *kernels)
+{
+    for (int isa = CPU_ISA_COUNT-1; isa > CPU_ISA_SCALAR; --isa) {
+        if (cpu_isa_kernel_supported(kernels, (::cpu_isa)isa)) {
+            return (::cpu_isa)isa;
+        }
+    }
+    return CPU_ISA_SCALAR;
+}
+
+::cpu_isa get_cpu_isa(::cpu_isa_kernels *kernels)
+{
+    ::cpu_isa isa = kernels->current.load(std::memory_order_relaxed);
+    if (isa == CPU_ISA_COUNT) {
+        // Only replaces the unpicked value, so an isa set in the meantime stays
+        isa = get_best_cpu_isa(kernels);
+        ::cpu_isa unpicked = CPU_ISA_COUNT;
+        kernels->current.compare_exchange_strong(unpicked, isa, std::memory_order_relaxed);
+        isa = kernels->current.load(std::memory_order_relaxed);
+    }
+    return isa;
+}
+
+void set_cpu_isa(::cpu_isa_kernels *kernels, ::cpu_isa isa)
+{
+    kernels->current.store(cpu_isa_kernel_supported(kernels, isa) ? isa : CPU_ISA_SCALAR, std::memory_order_relaxed);
+}
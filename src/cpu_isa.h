@@ -0,0 +1,48 @@
+#ifndef CT_CPU_ISA_H
+#define CT_CPU_ISA_H
+
+#include <atomic>
+#include <cstdint>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define CPU_ISA_X86
+#endif
+
+// Instruction sets the SIMD kernels are written for
+enum cpu_isa {
+    CPU_ISA_SCALAR,
+    CPU_ISA_SSE2,
+    CPU_ISA_SSE42,
+    CPU_ISA_AVX,
+    CPU_ISA_AVX2,
+    CPU_ISA_COUNT
+};
+
+#define CPU_ISA_BIT(isa) (uint32_t(1) << (isa))
+
+extern const char *cpu_isa_names[CPU_ISA_COUNT];
+
+// Whether the CPU runs isa, checked with CPUID
+bool cpu_isa_supported(::cpu_isa isa);
+
+// A family of kernels doing the same work on different instruction sets, and the one calls go to
+struct cpu_isa_kernels {
+    // CPU_ISA_BIT of every instruction set the family has a kernel for, scalar always among them
+    uint32_t available;
+    // CPU_ISA_COUNT until the first get_cpu_isa picks the best one the CPU runs
+    std::atomic<::cpu_isa> current;
+};
+
+// Whether the family has a kernel for isa and the CPU runs it
+bool cpu_isa_kernel_supported(::cpu_isa_kernels const *kernels, ::cpu_isa isa);
+
+// The best instruction set the family has a kernel for and the CPU runs
+::cpu_isa get_best_cpu_isa(::cpu_isa_kernels const *kernels);
+
+// The instruction set calls go to. Safe to read while another thread sets it.
+::cpu_isa get_cpu_isa(::cpu_isa_kernels *kernels);
+
+// Overrides the kernel picked from CPUID, falls back to scalar if isa is not supported
+void set_cpu_isa(::cpu_isa_kernels *kernels, ::cpu_isa isa);
+
+#endif
@@ -0,0 +1,121 @@
+#include "face_mask.h"
+#include <cstring>
+
+#ifdef CPU_ISA_X86
+#include <immintrin.h>
+#endif
+
+// One x row of a chunk, CHUNK_SIZE columns along z
+struct face_mask_row {
+    // column[-1] and column[CHUNK_SIZE] are the columns of the z neighbours
+    chunk_column const *column;
+    chunk_column const *px, *nx, *py, *ny;
+    chunk_column *out[CUBE_SIDE_COUNT];
+};
+
+static void face_mask_row_scalar(::face_mask_row const *row)
+{
+    for (int z = 0; z < CHUNK_SIZE; ++z) {
+        chunk_column column = row->column[z];
+        // Blocks above and below, shifted in from the neighbouring columns
+        chunk_column py = (column >> 1) | (row->py[z] << (CHUNK_SIZE-1));
+        chunk_column ny = (column << 1) | (row->ny[z] >> (CHUNK_SIZE-1));
+
+        row->out[CUBE_SIDE_PX][z] = column & ~row->px[z];
+        row->out[CUBE_SIDE_NX][z] = column & ~row->nx[z];
+        row->out[CUBE_SIDE_PY][z] = column & ~py;
+        row->out[CUBE_SIDE_NY][z] = column & ~ny;
+        row->out[CUBE_SIDE_PZ][z] = column & ~row->column[z+1];
+        row->out[CUBE_SIDE_NZ][z] = column & ~row->column[z-1];
+    }
+}
+
+#ifdef CPU_ISA_X86
+#define LOAD_128(p) _mm_loadu_si128((__m128i const*)(p))
+#define STORE_128(p, v) _mm_storeu_si128((__m128i*)(p), v)
+
+__attribute__((target("sse4.2")))
+static void face_mask_row_sse42(::face_mask_row const *row)
+{
+    for (int z = 0; z < CHUNK_SIZE; z += 4) {
+        __m128i column = LOAD_128(row->column + z);
+        __m128i py = _mm_or_si128(_mm_srli_epi32(column, 1), _mm_slli_epi32(LOAD_128(row->py + z), CHUNK_SIZE-1));
+        __m128i ny = _mm_or_si128(_mm_slli_epi32(column, 1), _mm_srli_epi32(LOAD_128(row->ny + z), CHUNK_SIZE-1));
+
+        // andnot(a, b) is ~a & b
+        STORE_128(row->out[CUBE_SIDE_PX] + z, _mm_andnot_si128(LOAD_128(row->px + z), column));
+        STORE_128(row->out[CUBE_SIDE_NX] + z, _mm_andnot_si128(LOAD_128(row->nx + z), column));
+        STORE_128(row->out[CUBE_SIDE_PY] + z, _mm_andnot_si128(py, column));
+        STORE_128(row->out[CUBE_SIDE_NY] + z, _mm_andnot_si128(ny, column));
+        STORE_128(row->out[CUBE_SIDE_PZ] + z, _mm_andnot_si128(LOAD_128(row->column + z + 1), column));
+        STORE_128(row->out[CUBE_SIDE_NZ] + z, _mm_andnot_si128(LOAD_128(row->column + z - 1), column));
+    }
+}
+
+#define LOAD_256(p) _mm256_loadu_si256((__m256i const*)(p))
+#define STORE_256(p, v) _mm256_storeu_si256((__m256i*)(p), v)
+
+__attribute__((target("avx2")))
+static void face_mask_row_avx2(::face_mask_row const *row)
+{
+    for (int z = 0; z < CHUNK_SIZE; z += 8) {
+        __m256i column = LOAD_256(row->column + z);
+        __m256i py = _mm256_or_si256(_mm256_srli_epi32(column, 1), _mm256_slli_epi32(LOAD_256(row->py + z), CHUNK_SIZE-1));
+        __m256i ny = _mm256_or_si256(_mm256_slli_epi32(column, 1), _mm256_srli_epi32(LOAD_256(row->ny + z), CHUNK_SIZE-1));
+
+        STORE_256(row->out[CUBE_SIDE_PX] + z, _mm256_andnot_si256(LOAD_256(row->px + z), column));
+        STORE_256(row->out[CUBE_SIDE_NX] + z, _mm256_andnot_si256(LOAD_256(row->nx + z), column));
+        STORE_256(row->out[CUBE_SIDE_PY] + z, _mm256_andnot_si256(py, column));
+        STORE_256(row->out[CUBE_SIDE_NY] + z, _mm256_andnot_si256(ny, column));
+        STORE_256(row->out[CUBE_SIDE_PZ] + z, _mm256_andnot_si256(LOAD_256(row->column + z + 1), column));
+        STORE_256(row->out[CUBE_SIDE_NZ] + z, _mm256_andnot_si256(LOAD_256(row->column + z - 1), column));
+    }
+}
+#endif
+
+typedef void (*face_mask_row_fn)(::face_mask_row const *row);
+
+#ifdef CPU_ISA_X86
+::cpu_isa_kernels face_mask_kernels = {CPU_ISA_BIT(CPU_ISA_SCALAR) | CPU_ISA_BIT(CPU_ISA_SSE42) | CPU_ISA_BIT(CPU_ISA_AVX2), {CPU_ISA_COUNT}};
+#else
+::cpu_isa_kernels face_mask_kernels = {CPU_ISA_BIT(CPU_ISA_SCALAR), {CPU_ISA_COUNT}};
+#endif
+
+static face_mask_row_fn get_face_mask_kernel(::cpu_isa isa)
+{
+    switch (isa) {
+#ifdef CPU_ISA_X86
+        case CPU_ISA_SSE42:
+            return face_mask_row_sse42;
+        case CPU_ISA_AVX2:
+            return face_mask_row_avx2;
+#endif
+        default:
+            return face_mask_row_scalar;
+    }
+}
+
+void compute_chunk_face_masks(::chunk *chunk, ::chunk const *const neighbours[CUBE_SIDE_COUNT])
+{
+    const face_mask_row_fn kernel = get_face_mask_kernel(get_cpu_isa(&face_mask_kernels));
+
+    for (int x = 0; x < CHUNK_SIZE; ++x) {
+        // Pad the row with the z neighbours, so the kernels can load z-1 and z+1 without branching
+        chunk_column padded[CHUNK_SIZE+2];
+        padded[0] = neighbours[CUBE_SIDE_NZ]->data[x][CHUNK_SIZE-1];
+        memcpy(padded+1, chunk->data[x], sizeof chunk->data[x]);
+        padded[CHUNK_SIZE+1] = neighbours[CUBE_SIDE_PZ]->data[x][0];
+
+        ::face_mask_row row;
+        row.column = padded+1;
+        row.px = x+1 < CHUNK_SIZE ? chunk->data[x+1] : neighbours[CUBE_SIDE_PX]->data[0];
+        row.nx = x > 0 ? chunk->data[x-1] : neighbours[CUBE_SIDE_NX]->data[CHUNK_SIZE-1];
+        row.py = neighbours[CUBE_SIDE_PY]->data[x];
+        row.ny = neighbours[CUBE_SIDE_NY]->data[x];
+        for (int side = 0; side < CUBE_SIDE_COUNT; ++side) {
+            row.out[side] = chunk->mesh_map[side][x];
+        }
+
+        kernel(&row);
+    }
+}
@@ -0,0 +1,18 @@
+#ifndef CT_FACE_MASK_H
+#define CT_FACE_MASK_H
+
+#include "cpu_isa.h"
+#include "world.h"
+
+// Kernels of compute_chunk_face_masks: scalar, SSE4.2 and AVX2
+extern ::cpu_isa_kernels face_mask_kernels;
+
+/**
+ * @brief      Computes the mesh map of a chunk from its columns and the columns of its neighbours.
+ *
+ * @param      chunk       The chunk
+ * @param      neighbours  The neighbouring chunks, indexed by cube_side, none of them can be null
+ */
+void compute_chunk_face_masks(::chunk *chunk, ::chunk const *const neighbours[CUBE_SIDE_COUNT]);
+
+#endif
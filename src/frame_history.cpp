@@ -0,0 +1,107 @@
+#include "frame_history.h"
+#include "profiler.h"
+#include <algorithm>
+#include <cstdlib>
+
+void init_frame_history(::frame_history *history)
+{
+    history->frames = (::frame_record*)calloc(FRAME_HISTORY_SIZE, sizeof *history->frames);
+    history->frame_count = 0;
+    history->started = false;
+}
+
+void deinit_frame_history(::frame_history *history)
+{
+    free(history->frames);
+    history->frames = nullptr;
+    history->frame_count = 0;
+}
+
+static void get_frame_zones(::frame_record *frame, uint64_t begin_ticks)
+{
+    static ::profiler_record records[FRAME_HISTORY_MAX_ZONES];
+    size_t count = read_profiler_thread_events(begin_ticks, records, FRAME_HISTORY_MAX_ZONES);
+
+    // Events end children first, sort them by start with parents before their children
+    std::sort(records, records + count, [](::profiler_record const &a, ::profiler_record const &b) {
+        return a.begin != b.begin ? a.begin < b.begin : a.end > b.end;
+    });
+
+    double ms_per_tick = 1000.0 / get_profiler_clock_frequency();
+    uint64_t open_ends[FRAME_HISTORY_MAX_ZONES];
+    int depth = 0;
+
+    frame->zone_count = 0;
+    for (size_t i = 0; i < count; ++i) {
+        if (records[i].begin < begin_ticks) {
+            continue;
+        }
+        while (depth > 0 && open_ends[depth-1] <= records[i].begin) {
+            depth--;
+        }
+
+        ::frame_zone *zone = &frame->zones[frame->zone_count++];
+        zone->name = records[i].name;
+        zone->begin_ms = (records[i].begin - begin_ticks) * ms_per_tick;
+        zone->duration_ms = (records[i].end - records[i].begin) * ms_per_tick;
+        zone->depth = depth;
+        open_ends[depth++] = records[i].end;
+    }
+}
+
+void begin_frame_history(::frame_history *history)
+{
+    auto now = std::chrono::steady_clock::now();
+    uint64_t now_ticks = read_profiler_clock();
+
+    if (history->started) {
+        ::frame_record *frame = &history->frames[history->frame_count % FRAME_HISTORY_SIZE];
+        frame->duration_ms = std::chrono::duration<float, std::milli>(now - history->frame_begin_time).count();
+        if (is_profiler_enabled()) {
+            get_frame_zones(frame, history->frame_begin_ticks);
+        } else {
+            frame->zone_count = 0;
+        }
+        history->frame_count++;
+    }
+
+    history->started = true;
+    history->frame_begin_time = now;
+    history->frame_begin_ticks = now_ticks;
+}
+
+size_t get_frame_history_count(::frame_history const *history)
+{
+    return history->frame_count < FRAME_HISTORY_SIZE ? history->frame_count : FRAME_HISTORY_SIZE;
+}
+
+::frame_record const* get_frame_history_record(::frame_history const *history, size_t age)
+{
+    return &history->frames[(history->frame_count - 1 - age) % FRAME_HISTORY_SIZE];
+}
+
+::frame_time_lows get_frame_time_lows(::frame_history const *history)
+{
+    ::frame_time_lows lows = {};
+    size_t count = get_frame_history_count(history);
+    if (count == 0) {
+        return lows;
+    }
+
+    static float sorted[FRAME_HISTORY_SIZE];
+    double total = 0;
+    for (size_t i = 0; i < count; ++i) {
+        sorted[i] = get_frame_history_record(history, i)->duration_ms;
+        total += sorted[i];
+    }
+
+    size_t low_1 = (count - 1) * 99 / 100;
+    size_t low_01 = (count - 1) * 999 / 1000;
+    std::nth_element(sorted, sorted + low_1, sorted + count);
+    lows.low_1_ms = sorted[low_1];
+    // Everything past low_1 is at least as slow, so the 0.1% low is in there
+    std::nth_element(sorted + low_1, sorted + low_01, sorted + count);
+    lows.low_01_ms = sorted[low_01];
+    lows.average_ms = total / count;
+    return lows;
+}
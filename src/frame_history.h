@@ -0,0 +1,64 @@
+#ifndef CT_FRAME_HISTORY_H
+#define CT_FRAME_HISTORY_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+// Frames kept, a few minutes of stutter at 60 FPS would need more but the spikes are what matter
+#define FRAME_HISTORY_SIZE 4096
+// Zones kept per frame, the ones beyond are dropped
+#define FRAME_HISTORY_MAX_ZONES 64
+
+// A profiler zone of the frame thread, relative to the start of the frame
+struct frame_zone {
+    char const *name;
+    float begin_ms, duration_ms;
+    // Nesting depth, 0 for zones not inside another zone
+    int depth;
+};
+
+struct frame_record {
+    // From the start of this frame to the start of the next one
+    float duration_ms;
+    size_t zone_count;
+    ::frame_zone zones[FRAME_HISTORY_MAX_ZONES];
+};
+
+struct frame_history {
+    ::frame_record *frames;
+    // Frames recorded since init, frame n is at frames[n % FRAME_HISTORY_SIZE]
+    uint64_t frame_count;
+
+    bool started;
+    uint64_t frame_begin_ticks;
+    std::chrono::steady_clock::time_point frame_begin_time;
+};
+
+// Frame times with the same share of frames being slower, the "1% low" is the 99th percentile
+struct frame_time_lows {
+    float average_ms;
+    float low_1_ms;
+    float low_01_ms;
+};
+
+void init_frame_history(::frame_history *history);
+void deinit_frame_history(::frame_history *history);
+
+/**
+ * @brief      Records the frame that just ended, with the zones the calling thread
+ *             recorded during it, and starts the next one. Call it at the start of each frame.
+ *
+ * @param      history  The history
+ */
+void begin_frame_history(::frame_history *history);
+
+// The number of frames available, up to FRAME_HISTORY_SIZE
+size_t get_frame_history_count(::frame_history const *history);
+
+// Gets a frame by age, 0 being the last one recorded
+::frame_record const* get_frame_history_record(::frame_history const *history, size_t age);
+
+::frame_time_lows get_frame_time_lows(::frame_history const *history);
+
+#endif
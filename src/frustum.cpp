@@ -0,0 +1,166 @@
+#include "frustum.h"
+
+#ifdef CPU_ISA_X86
+#include <immintrin.h>
+#endif
+
+::frustum get_frustum(hmm_mat4 const &vp)
+{
+    // Elements are column major, so row r is Elements[0..3][r]
+    hmm_vec4 rows[4];
+    for (int r = 0; r < 4; ++r) {
+        rows[r] = {vp.Elements[0][r], vp.Elements[1][r], vp.Elements[2][r], vp.Elements[3][r]};
+    }
+
+    ::frustum result = {};
+    result.planes[FRUSTUM_PLANE_LEFT] = rows[3] + rows[0];
+    result.planes[FRUSTUM_PLANE_RIGHT] = rows[3] - rows[0];
+    result.planes[FRUSTUM_PLANE_BOTTOM] = rows[3] + rows[1];
+    result.planes[FRUSTUM_PLANE_TOP] = rows[3] - rows[1];
+    result.planes[FRUSTUM_PLANE_NEAR] = rows[3] + rows[2];
+    result.planes[FRUSTUM_PLANE_FAR] = rows[3] - rows[2];
+
+    for (auto &plane : result.planes) {
+        float length = HMM_LengthVec3(plane.XYZ);
+        if (length > 0) {
+            plane = plane / length;
+        }
+    }
+    return result;
+}
+
+// For each plane the corner of a box furthest along its normal, if that one is behind the plane so is the box
+struct frustum_cull_plane {
+    float normal[3];
+    float distance;
+    // Whether to take the max (true) or the min (false) of each axis
+    bool positive[3];
+};
+
+static void get_frustum_cull_planes(::frustum const *frustum, ::frustum_cull_plane planes[FRUSTUM_PLANE_COUNT])
+{
+    for (int p = 0; p < FRUSTUM_PLANE_COUNT; ++p) {
+        for (int axis = 0; axis < 3; ++axis) {
+            planes[p].normal[axis] = frustum->planes[p].Elements[axis];
+            planes[p].positive[axis] = frustum->planes[p].Elements[axis] >= 0;
+        }
+        planes[p].distance = frustum->planes[p].W;
+    }
+}
+
+static size_t cull_frustum_boxes_scalar(::frustum_cull_plane const *planes, ::frustum_boxes const *boxes, size_t begin, bool *visible)
+{
+    size_t visible_count = 0;
+    for (size_t i = begin; i < boxes->count; ++i) {
+        float const *min[3] = {boxes->min_x, boxes->min_y, boxes->min_z};
+        float const *max[3] = {boxes->max_x, boxes->max_y, boxes->max_z};
+
+        bool inside = true;
+        for (int p = 0; p < FRUSTUM_PLANE_COUNT && inside; ++p) {
+            float distance = planes[p].distance;
+            for (int axis = 0; axis < 3; ++axis) {
+                distance += planes[p].normal[axis] * (planes[p].positive[axis] ? max[axis][i] : min[axis][i]);
+            }
+            inside = distance >= 0;
+        }
+
+        visible[i] = inside;
+        visible_count += inside;
+    }
+    return visible_count;
+}
+
+#ifdef CPU_ISA_X86
+__attribute__((target("sse2")))
+static size_t cull_frustum_boxes_sse(::frustum_cull_plane const *planes, ::frustum_boxes const *boxes, bool *visible)
+{
+    float const *min[3] = {boxes->min_x, boxes->min_y, boxes->min_z};
+    float const *max[3] = {boxes->max_x, boxes->max_y, boxes->max_z};
+
+    size_t visible_count = 0;
+    size_t i = 0;
+    for (; i + 4 <= boxes->count; i += 4) {
+        __m128 lo[3], hi[3];
+        for (int axis = 0; axis < 3; ++axis) {
+            lo[axis] = _mm_loadu_ps(min[axis] + i);
+            hi[axis] = _mm_loadu_ps(max[axis] + i);
+        }
+
+        __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        for (int p = 0; p < FRUSTUM_PLANE_COUNT; ++p) {
+            __m128 distance = _mm_set1_ps(planes[p].distance);
+            for (int axis = 0; axis < 3; ++axis) {
+                __m128 corner = planes[p].positive[axis] ? hi[axis] : lo[axis];
+                distance = _mm_add_ps(distance, _mm_mul_ps(_mm_set1_ps(planes[p].normal[axis]), corner));
+            }
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, _mm_setzero_ps()));
+        }
+
+        int mask = _mm_movemask_ps(inside);
+        for (int j = 0; j < 4; ++j) {
+            visible[i+j] = (mask >> j) & 1;
+        }
+        visible_count += __builtin_popcount(mask);
+    }
+
+    return visible_count + cull_frustum_boxes_scalar(planes, boxes, i, visible);
+}
+
+__attribute__((target("avx")))
+static size_t cull_frustum_boxes_avx(::frustum_cull_plane const *planes, ::frustum_boxes const *boxes, bool *visible)
+{
+    float const *min[3] = {boxes->min_x, boxes->min_y, boxes->min_z};
+    float const *max[3] = {boxes->max_x, boxes->max_y, boxes->max_z};
+
+    size_t visible_count = 0;
+    size_t i = 0;
+    for (; i + 8 <= boxes->count; i += 8) {
+        __m256 lo[3], hi[3];
+        for (int axis = 0; axis < 3; ++axis) {
+            lo[axis] = _mm256_loadu_ps(min[axis] + i);
+            hi[axis] = _mm256_loadu_ps(max[axis] + i);
+        }
+
+        __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+        for (int p = 0; p < FRUSTUM_PLANE_COUNT; ++p) {
+            __m256 distance = _mm256_set1_ps(planes[p].distance);
+            for (int axis = 0; axis < 3; ++axis) {
+                __m256 corner = planes[p].positive[axis] ? hi[axis] : lo[axis];
+                distance = _mm256_add_ps(distance, _mm256_mul_ps(_mm256_set1_ps(planes[p].normal[axis]), corner));
+            }
+            inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, _mm256_setzero_ps(), _CMP_GE_OQ));
+        }
+
+        int mask = _mm256_movemask_ps(inside);
+        for (int j = 0; j < 8; ++j) {
+            visible[i+j] = (mask >> j) & 1;
+        }
+        visible_count += __builtin_popcount(mask);
+    }
+
+    return visible_count + cull_frustum_boxes_scalar(planes, boxes, i, visible);
+}
+#endif
+
+#ifdef CPU_ISA_X86
+::cpu_isa_kernels frustum_cull_kernels = {CPU_ISA_BIT(CPU_ISA_SCALAR) | CPU_ISA_BIT(CPU_ISA_SSE2) | CPU_ISA_BIT(CPU_ISA_AVX), {CPU_ISA_COUNT}};
+#else
+::cpu_isa_kernels frustum_cull_kernels = {CPU_ISA_BIT(CPU_ISA_SCALAR), {CPU_ISA_COUNT}};
+#endif
+
+size_t cull_frustum_boxes(::frustum const *frustum, ::frustum_boxes const *boxes, bool *visible)
+{
+    ::frustum_cull_plane planes[FRUSTUM_PLANE_COUNT];
+    get_frustum_cull_planes(frustum, planes);
+
+    switch (get_cpu_isa(&frustum_cull_kernels)) {
+#ifdef CPU_ISA_X86
+        case CPU_ISA_SSE2:
+            return cull_frustum_boxes_sse(planes, boxes, visible);
+        case CPU_ISA_AVX:
+            return cull_frustum_boxes_avx(planes, boxes, visible);
+#endif
+        default:
+            return cull_frustum_boxes_scalar(planes, boxes, 0, visible);
+    }
+}
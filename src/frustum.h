@@ -0,0 +1,49 @@
+#ifndef CT_FRUSTUM_H
+#define CT_FRUSTUM_H
+
+#include <cstddef>
+#include "lib/HandmadeMath.h"
+#include "cpu_isa.h"
+
+enum frustum_plane {
+    FRUSTUM_PLANE_LEFT,
+    FRUSTUM_PLANE_RIGHT,
+    FRUSTUM_PLANE_BOTTOM,
+    FRUSTUM_PLANE_TOP,
+    FRUSTUM_PLANE_NEAR,
+    FRUSTUM_PLANE_FAR,
+    FRUSTUM_PLANE_COUNT
+};
+
+// Planes facing inwards, XYZ is the unit normal and W the distance, so dot(XYZ, p) + W >= 0 inside
+struct frustum {
+    hmm_vec4 planes[FRUSTUM_PLANE_COUNT];
+};
+
+// Extracts the planes from a view projection matrix with OpenGL clip space (Gribb and Hartmann)
+::frustum get_frustum(hmm_mat4 const &vp);
+
+// Axis aligned boxes laid out component by component, so the kernels load a batch of them at once
+struct frustum_boxes {
+    float const *min_x, *min_y, *min_z;
+    float const *max_x, *max_y, *max_z;
+    size_t count;
+};
+
+// Kernels of cull_frustum_boxes: scalar, SSE2 and AVX
+extern ::cpu_isa_kernels frustum_cull_kernels;
+
+/**
+ * @brief      Tests boxes against the frustum, 4 (SSE) or 8 (AVX) at a time. A box is
+ *             culled when it is fully behind one of the planes, so boxes near the corners
+ *             of the frustum can pass while being outside.
+ *
+ * @param      frustum  The frustum
+ * @param      boxes    The boxes
+ * @param      visible  Set for each box, whether it is (maybe) visible
+ *
+ * @return     The number of visible boxes
+ */
+size_t cull_frustum_boxes(::frustum const *frustum, ::frustum_boxes const *boxes, bool *visible);
+
+#endif
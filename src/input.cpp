@@ -55,4 +55,41 @@ void input::pass_event(const sapp_event *event)
         default:
             break;
     }
-}
\ No newline at end of file
+}
+
+void handle_camera_input(::camera *camera, ::input const &input, float time_step)
+{
+    float step = CAMERA_MOVE_SPEED * time_step;
+    float forward = 0, sideways = 0, upward = 0;
+
+    camera->rotate(hmm_vec2{input.mouse_delta.Y/4, -input.mouse_delta.X/4});
+
+    if (input.key_states[SAPP_KEYCODE_LEFT_SHIFT].held) {
+        upward -= step;
+    }
+
+    if (input.key_states[SAPP_KEYCODE_SPACE].held) {
+        upward += step;
+    }
+
+    if (input.key_states[SAPP_KEYCODE_W].held) {
+        forward += step;
+    }
+
+    if (input.key_states[SAPP_KEYCODE_S].held) {
+        forward -= step;
+    }
+
+    if (input.key_states[SAPP_KEYCODE_A].held) {
+        sideways += step;
+    }
+
+    if (input.key_states[SAPP_KEYCODE_D].held) {
+        sideways -= step;
+    }
+
+    // One move, the keys only add up
+    if (forward != 0 || sideways != 0 || upward != 0) {
+        camera->move(forward, sideways, upward);
+    }
+}
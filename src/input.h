@@ -20,4 +20,10 @@ struct input {
     void pass_event(const sapp_event *event);
 };
 
+// Blocks per second, what a block per frame used to be at 60 FPS
+#define CAMERA_MOVE_SPEED 60.0f
+
+// Flies the camera around for a time step in seconds, mouse to look and WASD/space/shift to move
+void handle_camera_input(::camera *camera, ::input const &input, float time_step);
+
 #endif
\ No newline at end of file
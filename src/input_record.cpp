@@ -0,0 +1,188 @@
+#include "input_record.h"
+#include <cstdlib>
+#include <cstring>
+
+#define INPUT_RECORD_KEY_COUNT (sizeof(::input::key_states) / sizeof(::input_key))
+#define INPUT_RECORD_BUTTON_COUNT (INPUT_RECORD_KEY_COUNT + sizeof(::input::mouse_states) / sizeof(::input_key))
+#define INPUT_RECORD_HEADER_SIZE (8 + 6*sizeof(float))
+//                                duration, aspect, delta, pos   flags  changes
+#define INPUT_RECORD_FRAME_SIZE  (6*sizeof(float) + 1 + 2)
+#define INPUT_RECORD_CHANGE_SIZE 3
+
+static_assert(INPUT_RECORD_BUTTON_COUNT <= UINT16_MAX, "Buttons are stored in 16 bits");
+
+static ::input_key *get_input_button(::input *input, size_t button)
+{
+    if (button < INPUT_RECORD_KEY_COUNT) {
+        return &input->key_states[button];
+    }
+    return &input->mouse_states[button - INPUT_RECORD_KEY_COUNT];
+}
+
+static uint8_t pack_input_key(::input_key key)
+{
+    return (key.pressed ? INPUT_RECORD_STATE_PRESSED : 0)
+         | (key.released ? INPUT_RECORD_STATE_RELEASED : 0)
+         | (key.held ? INPUT_RECORD_STATE_HELD : 0);
+}
+
+static ::input_key unpack_input_key(uint8_t state)
+{
+    return {(state & INPUT_RECORD_STATE_PRESSED) != 0, (state & INPUT_RECORD_STATE_RELEASED) != 0, (state & INPUT_RECORD_STATE_HELD) != 0};
+}
+
+static uint8_t *write_bytes(uint8_t *output, void const *data, size_t size)
+{
+    memcpy(output, data, size);
+    return output + size;
+}
+
+static uint8_t const *read_bytes(uint8_t const *input, void *data, size_t size)
+{
+    memcpy(data, input, size);
+    return input + size;
+}
+
+bool begin_input_recording(::input_recorder *recorder, char const *path, ::camera const *camera, float tick_rate)
+{
+    *recorder = {};
+    recorder->file = fopen(path, "wb");
+    if (!recorder->file) {
+        fprintf(stderr, "Input recording: can not open %s\n", path);
+        return false;
+    }
+
+    uint8_t header[INPUT_RECORD_HEADER_SIZE];
+    uint32_t version = INPUT_RECORD_VERSION;
+    uint8_t *output = write_bytes(write_bytes(header, INPUT_RECORD_MAGIC, 4), &version, sizeof version);
+    output = write_bytes(output, camera->position.Elements, 3*sizeof(float));
+    output = write_bytes(output, camera->yaw_pitch.Elements, 2*sizeof(float));
+    write_bytes(output, &tick_rate, sizeof tick_rate);
+    fwrite(header, sizeof header, 1, recorder->file);
+    return true;
+}
+
+void record_input_frame(::input_recorder *recorder, ::input_frame const *frame)
+{
+    if (!recorder->file) {
+        return;
+    }
+
+    uint8_t buffer[INPUT_RECORD_FRAME_SIZE + INPUT_RECORD_BUTTON_COUNT*INPUT_RECORD_CHANGE_SIZE];
+    uint8_t *changes = buffer + INPUT_RECORD_FRAME_SIZE;
+    uint16_t change_count = 0;
+    ::input input = frame->input;
+    for (size_t button = 0; button < INPUT_RECORD_BUTTON_COUNT; ++button) {
+        uint8_t state = pack_input_key(*get_input_button(&input, button));
+        if (state != pack_input_key(*get_input_button(&recorder->previous, button))) {
+            uint16_t code = (uint16_t)button;
+            changes = write_bytes(write_bytes(changes, &code, sizeof code), &state, sizeof state);
+            ++change_count;
+        }
+    }
+
+    uint8_t flags = frame->mouse_locked ? INPUT_RECORD_FLAG_MOUSE_LOCKED : 0;
+    uint8_t *output = buffer;
+    output = write_bytes(output, &frame->duration, sizeof(float));
+    output = write_bytes(output, &frame->aspect, sizeof(float));
+    output = write_bytes(output, frame->input.mouse_delta.Elements, 2*sizeof(float));
+    output = write_bytes(output, frame->input.mouse_pos.Elements, 2*sizeof(float));
+    output = write_bytes(output, &flags, sizeof flags);
+    output = write_bytes(output, &change_count, sizeof change_count);
+    fwrite(buffer, changes - buffer, 1, recorder->file);
+
+    recorder->previous = frame->input;
+    recorder->previous.update();
+    ++recorder->frame_count;
+}
+
+void end_input_recording(::input_recorder *recorder)
+{
+    if (recorder->file) {
+        fclose(recorder->file);
+    }
+    *recorder = {};
+}
+
+bool load_input_replay(::input_replay *replay, char const *path)
+{
+    *replay = {};
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        fprintf(stderr, "Input replay: can not open %s\n", path);
+        return false;
+    }
+
+    fseek(file, 0, SEEK_END);
+    long length = ftell(file);
+    size_t size = length > 0 ? (size_t)length : 0;
+    fseek(file, 0, SEEK_SET);
+    uint8_t *data = size > 0 ? (uint8_t*)malloc(size) : nullptr;
+    bool read = data && fread(data, size, 1, file) == 1;
+    fclose(file);
+
+    uint32_t version = 0;
+    if (read && size >= INPUT_RECORD_HEADER_SIZE) {
+        read_bytes(data + 4, &version, sizeof version);
+    }
+    if (!read || size < INPUT_RECORD_HEADER_SIZE || memcmp(data, INPUT_RECORD_MAGIC, 4) != 0 || version != INPUT_RECORD_VERSION) {
+        fprintf(stderr, "Input replay: %s is not an input recording (version %d)\n", path, INPUT_RECORD_VERSION);
+        free(data);
+        return false;
+    }
+
+    uint8_t const *header = read_bytes(data + 8, replay->camera_position.Elements, 3*sizeof(float));
+    header = read_bytes(header, replay->camera_yaw_pitch.Elements, 2*sizeof(float));
+    read_bytes(header, &replay->tick_rate, sizeof replay->tick_rate);
+    replay->data = data;
+    replay->size = size;
+    replay->offset = INPUT_RECORD_HEADER_SIZE;
+    return true;
+}
+
+bool replay_input_frame(::input_replay *replay, ::input_frame *frame)
+{
+    if (replay->offset + INPUT_RECORD_FRAME_SIZE > replay->size) {
+        return false;
+    }
+
+    ::input input = replay->previous;
+    uint8_t flags;
+    uint16_t change_count;
+    uint8_t const *data = replay->data + replay->offset;
+    data = read_bytes(data, &frame->duration, sizeof(float));
+    data = read_bytes(data, &frame->aspect, sizeof(float));
+    data = read_bytes(data, input.mouse_delta.Elements, 2*sizeof(float));
+    data = read_bytes(data, input.mouse_pos.Elements, 2*sizeof(float));
+    data = read_bytes(data, &flags, sizeof flags);
+    data = read_bytes(data, &change_count, sizeof change_count);
+
+    if (replay->offset + INPUT_RECORD_FRAME_SIZE + (size_t)change_count*INPUT_RECORD_CHANGE_SIZE > replay->size) {
+        fprintf(stderr, "Input replay: recording cut short at frame %llu\n", (unsigned long long)replay->frame_count);
+        replay->offset = replay->size;
+        return false;
+    }
+
+    for (uint16_t i = 0; i < change_count; ++i) {
+        uint16_t button;
+        uint8_t state;
+        data = read_bytes(read_bytes(data, &button, sizeof button), &state, sizeof state);
+        if (button < INPUT_RECORD_BUTTON_COUNT) {
+            *get_input_button(&input, button) = unpack_input_key(state);
+        }
+    }
+
+    frame->input = input;
+    frame->mouse_locked = (flags & INPUT_RECORD_FLAG_MOUSE_LOCKED) != 0;
+    replay->previous = input;
+    replay->previous.update();
+    replay->offset = data - replay->data;
+    ++replay->frame_count;
+    return true;
+}
+
+void unload_input_replay(::input_replay *replay)
+{
+    free(replay->data);
+    *replay = {};
+}
@@ -0,0 +1,74 @@
+#ifndef CT_INPUT_RECORD_H
+#define CT_INPUT_RECORD_H
+
+#include <cstdint>
+#include <cstdio>
+#include "input.h"
+
+// A recording is a header followed by one frame after another, all little endian:
+//   header: "CTIN", u32 version, f32 camera position x y z, f32 camera yaw pitch, f32 tick rate
+//   frame:  f32 duration, f32 aspect, f32 mouse_delta x y, f32 mouse_pos x y, u8 flags, u16 change count,
+//           then per change: u16 button, u8 state (INPUT_RECORD_STATE_* bits)
+// Buttons are key codes, mouse buttons follow after the keys.
+// A change is a button whose state differs from the state it was left in by the previous input::update,
+// so a held key costs nothing until it is released.
+#define INPUT_RECORD_MAGIC "CTIN"
+#define INPUT_RECORD_VERSION 2
+
+#define INPUT_RECORD_STATE_PRESSED  (1 << 0)
+#define INPUT_RECORD_STATE_RELEASED (1 << 1)
+#define INPUT_RECORD_STATE_HELD     (1 << 2)
+
+#define INPUT_RECORD_FLAG_MOUSE_LOCKED (1 << 0)
+
+// Everything a frame of the app consumes that does not come from the world itself
+struct input_frame {
+    ::input input;
+    bool mouse_locked;
+    float aspect;
+    // Seconds
+    float duration;
+};
+
+struct input_recorder {
+    FILE *file;
+    // The input as the previous frame's input::update left it
+    ::input previous;
+    uint64_t frame_count;
+};
+
+// Returns false if the file can not be opened. The replay starts from the camera, simulated at the tick rate.
+bool begin_input_recording(::input_recorder *recorder, char const *path, ::camera const *camera, float tick_rate);
+// Writes out a frame, call it once per frame before input::update
+void record_input_frame(::input_recorder *recorder, ::input_frame const *frame);
+void end_input_recording(::input_recorder *recorder);
+
+struct input_replay {
+    uint8_t *data;
+    size_t size;
+    size_t offset;
+    // The input as the previous replayed frame left it after input::update
+    ::input previous;
+    uint64_t frame_count;
+    // The camera when the recording began
+    hmm_vec3 camera_position;
+    hmm_vec2 camera_yaw_pitch;
+    float tick_rate;
+};
+
+// Reads the whole recording into memory, returns false if it can not be read or is not a recording
+bool load_input_replay(::input_replay *replay, char const *path);
+
+/**
+ * @brief      Reads the next frame of a recording. The input of the frame is rebuilt exactly as it was
+ *             recorded, no matter what happened to the live input in between.
+ *
+ * @param      replay  The replay
+ * @param      frame   The frame
+ *
+ * @return     false once the recording is over, or if it is cut short
+ */
+bool replay_input_frame(::input_replay *replay, ::input_frame *frame);
+void unload_input_replay(::input_replay *replay);
+
+#endif
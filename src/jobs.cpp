@@ -0,0 +1,400 @@
+#include "jobs.h"
+#include "profiler.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+// The system and deque of the calling thread, the deque is -1 on threads without one
+static thread_local ::job_system *GLOBAL_current_system;
+static thread_local int GLOBAL_current_deque = -1;
+static thread_local ::job_task *GLOBAL_current_task;
+static thread_local uint32_t GLOBAL_steal_seed = 0x9E3779B9;
+
+static bool push_job_deque(::job_deque *deque, ::job_task *task)
+{
+    int64_t bottom = deque->bottom.load(std::memory_order_relaxed);
+    int64_t top = deque->top.load(std::memory_order_acquire);
+    if (bottom - top >= JOBS_DEQUE_CAPACITY) {
+        return false;
+    }
+
+    deque->tasks[bottom % JOBS_DEQUE_CAPACITY].store(task, std::memory_order_relaxed);
+    // Publishes the task to thieves
+    deque->bottom.store(bottom + 1, std::memory_order_release);
+    return true;
+}
+
+// Only the owner takes, from the bottom
+static ::job_task* take_job_deque(::job_deque *deque)
+{
+    int64_t bottom = deque->bottom.load(std::memory_order_relaxed) - 1;
+    deque->bottom.store(bottom, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t top = deque->top.load(std::memory_order_relaxed);
+
+    if (top > bottom) {
+        // Empty
+        deque->bottom.store(bottom + 1, std::memory_order_relaxed);
+        return nullptr;
+    }
+
+    ::job_task *task = deque->tasks[bottom % JOBS_DEQUE_CAPACITY].load(std::memory_order_relaxed);
+    if (top == bottom) {
+        // Last one, race the thieves for it
+        if (!deque->top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+            task = nullptr;
+        }
+        deque->bottom.store(bottom + 1, std::memory_order_relaxed);
+    }
+    return task;
+}
+
+// Any thread steals, from the top
+static ::job_task* steal_job_deque(::job_deque *deque)
+{
+    int64_t top = deque->top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t bottom = deque->bottom.load(std::memory_order_acquire);
+
+    if (top >= bottom) {
+        return nullptr;
+    }
+
+    ::job_task *task = deque->tasks[top % JOBS_DEQUE_CAPACITY].load(std::memory_order_relaxed);
+    if (!deque->top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+        // Lost to the owner or another thief
+        return nullptr;
+    }
+    return task;
+}
+
+static int get_job_deque_count(::job_system const *jobs)
+{
+    return jobs->worker_count + 1;
+}
+
+static ::job_task* find_job_task(::job_system *jobs, int own_deque)
+{
+    ::job_task *task = nullptr;
+
+    if (own_deque >= 0) {
+        task = take_job_deque(&jobs->deques[own_deque]);
+    }
+
+    if (task == nullptr) {
+        // Start at a random victim so the thieves spread out
+        GLOBAL_steal_seed ^= GLOBAL_steal_seed << 13;
+        GLOBAL_steal_seed ^= GLOBAL_steal_seed >> 17;
+        GLOBAL_steal_seed ^= GLOBAL_steal_seed << 5;
+
+        int deque_count = get_job_deque_count(jobs);
+        int start = GLOBAL_steal_seed % deque_count;
+        for (int i = 0; i < deque_count && task == nullptr; ++i) {
+            int victim = (start + i) % deque_count;
+            if (victim != own_deque) {
+                task = steal_job_deque(&jobs->deques[victim]);
+            }
+        }
+    }
+
+    if (task == nullptr) {
+        std::lock_guard<std::mutex> lock(jobs->injected_mutex);
+        if (jobs->injected_first < jobs->injected_size) {
+            task = jobs->injected[jobs->injected_first++];
+            if (jobs->injected_first == jobs->injected_size) {
+                jobs->injected_first = 0;
+                jobs->injected_size = 0;
+            }
+        }
+    }
+
+    if (task) {
+        jobs->queued.fetch_sub(1, std::memory_order_relaxed);
+    }
+    return task;
+}
+
+static void finish_job_task(::job_task *task)
+{
+    // Whoever finishes the last piece of a task finishes it, and maybe its parent in turn
+    while (task && task->unfinished.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        if (task->counter) {
+            task->counter->value.fetch_sub(1, std::memory_order_release);
+        }
+        ::job_task *parent = task->parent;
+        delete task;
+        task = parent;
+    }
+}
+
+static void run_job_task(::job_task *task)
+{
+    ::job_task *previous = GLOBAL_current_task;
+    GLOBAL_current_task = task;
+    task->job.run(task->job.context, task->job.data);
+    GLOBAL_current_task = previous;
+
+    finish_job_task(task);
+}
+
+static int get_own_job_deque(::job_system const *jobs)
+{
+    return GLOBAL_current_system == jobs ? GLOBAL_current_deque : -1;
+}
+
+static void worker_loop(::job_system *jobs, int deque)
+{
+    GLOBAL_current_system = jobs;
+    GLOBAL_current_deque = deque;
+
+    char name[PROFILER_THREAD_NAME_SIZE];
+    snprintf(name, sizeof name, "Worker %d", deque);
+    set_profiler_thread_name(name);
+
+    for (;;) {
+        ::job_task *task = find_job_task(jobs, deque);
+        if (task) {
+            run_job_task(task);
+            continue;
+        }
+
+        if (jobs->queued.load() > 0) {
+            // Someone is about to push, or a thief is about to take it
+            std::this_thread::yield();
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(jobs->sleep_mutex);
+        if (jobs->quit.load()) {
+            return;
+        }
+        // Announce sleeping before checking the queue, submitters check in the opposite order
+        jobs->sleeping.fetch_add(1);
+        jobs->wake.wait(lock, [jobs] { return jobs->quit.load() || jobs->queued.load() > 0; });
+        jobs->sleeping.fetch_sub(1);
+    }
+}
+
+void init_job_system(::job_system *jobs, int worker_count)
+{
+    if (worker_count <= 0) {
+        worker_count = std::thread::hardware_concurrency();
+    }
+    if (worker_count <= 0) {
+        worker_count = 1;
+    }
+    if (worker_count > JOBS_MAX_WORKERS) {
+        worker_count = JOBS_MAX_WORKERS;
+    }
+
+    jobs->worker_count = worker_count;
+    jobs->deques = new ::job_deque[get_job_deque_count(jobs)];
+    for (int i = 0; i < get_job_deque_count(jobs); ++i) {
+        jobs->deques[i].top.store(0);
+        jobs->deques[i].bottom.store(0);
+    }
+
+    jobs->injected_capacity = 256;
+    jobs->injected = (::job_task**)malloc(jobs->injected_capacity * sizeof *jobs->injected);
+    jobs->injected_first = 0;
+    jobs->injected_size = 0;
+
+    jobs->queued.store(0);
+    jobs->sleeping.store(0);
+    jobs->quit.store(false);
+
+    // The initializing thread owns the last deque
+    GLOBAL_current_system = jobs;
+    GLOBAL_current_deque = worker_count;
+
+    for (int i = 0; i < worker_count; ++i) {
+        jobs->workers[i] = std::thread(worker_loop, jobs, i);
+    }
+}
+
+void deinit_job_system(::job_system *jobs)
+{
+    {
+        std::lock_guard<std::mutex> lock(jobs->sleep_mutex);
+        jobs->quit.store(true);
+    }
+    jobs->wake.notify_all();
+
+    // The workers only stop once they can't find anything left to run
+    for (int i = 0; i < jobs->worker_count; ++i) {
+        jobs->workers[i].join();
+    }
+
+    if (GLOBAL_current_system == jobs) {
+        GLOBAL_current_system = nullptr;
+        GLOBAL_current_deque = -1;
+    }
+
+    delete[] jobs->deques;
+    jobs->deques = nullptr;
+    jobs->worker_count = 0;
+
+    free(jobs->injected);
+    jobs->injected = nullptr;
+}
+
+static void submit_job_task(::job_system *jobs, ::job job, ::job_task *parent, ::job_counter *counter)
+{
+    ::job_task *task = new ::job_task;
+    task->job = job;
+    task->parent = parent;
+    task->counter = counter;
+    task->unfinished.store(1, std::memory_order_relaxed);
+
+    if (parent) {
+        parent->unfinished.fetch_add(1, std::memory_order_relaxed);
+    }
+    if (counter) {
+        counter->value.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Count it before it's visible, so a sleeping worker never misses it
+    jobs->queued.fetch_add(1);
+
+    // The frame thread only keeps what its own jobs spawn, everything else is up to the workers
+    int deque = get_own_job_deque(jobs);
+    if (deque == jobs->worker_count && GLOBAL_current_task == nullptr) {
+        deque = -1;
+    }
+    if (deque >= 0) {
+        if (!push_job_deque(&jobs->deques[deque], task)) {
+            // The deque is full, better to do the work than to wait for room
+            jobs->queued.fetch_sub(1);
+            run_job_task(task);
+            return;
+        }
+    } else {
+        std::lock_guard<std::mutex> lock(jobs->injected_mutex);
+        if (jobs->injected_size == jobs->injected_capacity && jobs->injected_first > 0) {
+            // Reuse the room in front of the ones taken already
+            jobs->injected_size -= jobs->injected_first;
+            memmove(jobs->injected, jobs->injected + jobs->injected_first, jobs->injected_size * sizeof *jobs->injected);
+            jobs->injected_first = 0;
+        }
+        if (jobs->injected_size == jobs->injected_capacity) {
+            jobs->injected_capacity *= 2;
+            jobs->injected = (::job_task**)realloc(jobs->injected, jobs->injected_capacity * sizeof *jobs->injected);
+        }
+        jobs->injected[jobs->injected_size++] = task;
+    }
+
+    if (jobs->sleeping.load() > 0) {
+        // Taking the lock makes sure the sleeper is either waiting or sees the job
+        std::lock_guard<std::mutex> lock(jobs->sleep_mutex);
+        jobs->wake.notify_one();
+    }
+}
+
+void submit_job(::job_system *jobs, ::job job, ::job_counter *counter)
+{
+    submit_job_task(jobs, job, nullptr, counter);
+}
+
+void submit_child_job(::job_system *jobs, ::job job, ::job_counter *counter)
+{
+    submit_job_task(jobs, job, GLOBAL_current_task, counter);
+}
+
+void wait_for_counter(::job_system *jobs, ::job_counter *counter)
+{
+    PROFILE_FUNCTION();
+    int deque = get_own_job_deque(jobs);
+    while (counter->value.load(std::memory_order_acquire) > 0) {
+        // Help out instead of blocking, waiting inside a job would otherwise deadlock. The frame thread's deque
+        // only holds pieces of what it is waiting for, stealing could get it stuck in a whole chunk generation.
+        ::job_task *task = nullptr;
+        if (deque == jobs->worker_count) {
+            task = take_job_deque(&jobs->deques[deque]);
+            if (task) {
+                jobs->queued.fetch_sub(1, std::memory_order_relaxed);
+            }
+        } else {
+            task = find_job_task(jobs, deque);
+        }
+        if (task) {
+            run_job_task(task);
+        } else {
+            std::this_thread::yield();
+        }
+    }
+}
+
+struct parallel_for_range {
+    ::job_system *jobs;
+    void (*body)(void *context, int x, int y, int z);
+    void *context;
+    int size_y, size_z;
+    int grain;
+    // Flattened indices, x major like WORLD_ITER
+    int begin, end;
+};
+
+static void run_parallel_for_range(void *context, void *data)
+{
+    (void)context;
+    ::parallel_for_range *range = (::parallel_for_range*)data;
+
+    // Hand the upper halves out until what's left is small enough to run here
+    while (range->end - range->begin > range->grain) {
+        int middle = range->begin + (range->end - range->begin) / 2;
+
+        ::parallel_for_range *upper = (::parallel_for_range*)malloc(sizeof *upper);
+        *upper = *range;
+        upper->begin = middle;
+        range->end = middle;
+
+        submit_child_job(range->jobs, {run_parallel_for_range, nullptr, upper});
+    }
+
+    int plane = range->size_y * range->size_z;
+    for (int i = range->begin; i < range->end; ++i) {
+        range->body(range->context, i / plane, i / range->size_z % range->size_y, i % range->size_z);
+    }
+
+    free(range);
+}
+
+void parallel_for_3d(::job_system *jobs, int size_x, int size_y, int size_z, int grain, void (*body)(void *context, int x, int y, int z), void *context)
+{
+    int count = size_x * size_y * size_z;
+    if (count <= 0) {
+        return;
+    }
+    if (grain < 1) {
+        grain = 1;
+    }
+
+    ::parallel_for_range *range = (::parallel_for_range*)malloc(sizeof *range);
+    *range = {jobs, body, context, size_y, size_z, grain, 0, count};
+
+    // Run right here rather than queued, so the pieces it hands out land in this thread's deque.
+    // The children keep the root unfinished, so the counter covers the whole range.
+    ::job_counter counter = {};
+    ::job_task *root = new ::job_task;
+    root->job = {run_parallel_for_range, nullptr, range};
+    root->parent = nullptr;
+    root->counter = &counter;
+    root->unfinished.store(1, std::memory_order_relaxed);
+    counter.value.store(1, std::memory_order_relaxed);
+    run_job_task(root);
+    wait_for_counter(jobs, &counter);
+}
+
+void push_job_result(::job_result_list *list, ::job_node *node)
+{
+    ::job_node *head = list->head.load(std::memory_order_relaxed);
+    do {
+        node->next = head;
+    } while (!list->head.compare_exchange_weak(head, node, std::memory_order_release, std::memory_order_relaxed));
+}
+
+::job_node* take_job_results(::job_result_list *list)
+{
+    // Only one consumer swaps the whole list out, so there is no ABA problem
+    return list->head.exchange(nullptr, std::memory_order_acquire);
+}
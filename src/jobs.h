@@ -0,0 +1,121 @@
+#ifndef CT_JOBS_H
+#define CT_JOBS_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+#define JOBS_MAX_WORKERS 64
+// Jobs one thread can have queued, a thread with a full deque runs new jobs right away
+#define JOBS_DEQUE_CAPACITY 4096
+
+struct job {
+    void (*run)(void *context, void *data);
+    void *context;
+    void *data;
+};
+
+// Counts unfinished jobs, see wait_for_counter
+struct job_counter {
+    std::atomic<int> value;
+};
+
+// A submitted job, alive until it and all of its children finished
+struct job_task {
+    ::job job;
+    ::job_task *parent;
+    ::job_counter *counter;
+    // The job itself plus its unfinished children
+    std::atomic<int> unfinished;
+};
+
+// Chase-Lev deque: the owning thread pushes and takes at the bottom, other threads steal from the top
+struct job_deque {
+    std::atomic<int64_t> top, bottom;
+    std::atomic<::job_task*> tasks[JOBS_DEQUE_CAPACITY];
+};
+
+struct job_system {
+    std::thread workers[JOBS_MAX_WORKERS];
+    int worker_count;
+
+    // One deque per worker, plus the last one for the thread that called init_job_system. That thread only
+    // pushes the children of jobs it runs itself there, see wait_for_counter.
+    ::job_deque *deques;
+
+    // Jobs submitted from threads without a deque, and jobs the init thread submits outside of any job.
+    // Taken oldest first, from injected_first on.
+    std::mutex injected_mutex;
+    ::job_task **injected;
+    size_t injected_capacity, injected_first, injected_size;
+
+    // Queued jobs nobody took yet, and workers sleeping until there are some
+    std::atomic<int64_t> queued;
+    std::atomic<int> sleeping;
+    std::mutex sleep_mutex;
+    std::condition_variable wake;
+    std::atomic<bool> quit;
+};
+
+/**
+ * @brief      Starts the worker threads. The calling thread (the frame thread) gets a deque too, for
+ *             the pieces of the parallel_for_3d calls it makes, and runs those while it waits.
+ *
+ * @param      jobs          The job system
+ * @param[in]  worker_count  The number of workers, 0 for one per core
+ */
+void init_job_system(::job_system *jobs, int worker_count);
+
+// Waits for the queued jobs to finish and joins the workers
+void deinit_job_system(::job_system *jobs);
+
+/**
+ * @brief      Queues a job. Can be called from any thread, including from inside jobs.
+ *
+ * @param      jobs     The job system
+ * @param[in]  job      The job
+ * @param      counter  Incremented now and decremented once the job finished, can be null
+ */
+void submit_job(::job_system *jobs, ::job job, ::job_counter *counter = nullptr);
+
+// Queues a job as a child of the job running on this thread. The running job only
+// counts as finished (for its counter and its own parent) once all of its children finished.
+void submit_child_job(::job_system *jobs, ::job job, ::job_counter *counter = nullptr);
+
+// Runs queued jobs until the counter drops to zero. The thread that called init_job_system only runs jobs from
+// its own deque, so it never picks up long unrelated jobs (e.g. chunk generation) while it waits.
+void wait_for_counter(::job_system *jobs, ::job_counter *counter);
+
+/**
+ * @brief      Runs body for every (x, y, z) in [0, size), in the same order as WORLD_ITER
+ *             and CHUNK_ITER within each batch, split over the workers. Returns once all of them ran.
+ *
+ * @param      jobs     The job system
+ * @param[in]  size_x   The size of the range on x
+ * @param[in]  size_y   The size of the range on y
+ * @param[in]  size_z   The size of the range on z
+ * @param[in]  grain    The most iterations one job runs
+ * @param[in]  body     The body
+ * @param      context  Passed to body
+ */
+void parallel_for_3d(::job_system *jobs, int size_x, int size_y, int size_z, int grain, void (*body)(void *context, int x, int y, int z), void *context);
+
+// Intrusive node for handing results back from workers
+struct job_node {
+    ::job_node *next;
+};
+
+// Lock-free list any thread can push to, and one thread takes everything from at once
+struct job_result_list {
+    std::atomic<::job_node*> head;
+};
+
+void push_job_result(::job_result_list *list, ::job_node *node);
+
+// Takes every result pushed so far, newest first
+::job_node* take_job_results(::job_result_list *list);
+
+#endif
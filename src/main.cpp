@@ -1,6 +1,10 @@
 // SPDX: MIT
+#include <algorithm>
+#include <chrono>
+#include <cmath>
 #include <cstdint>
 #include <cstdlib>
+#include <cstring>
 #include <strings.h>
 #define SOKOL_IMPL
 #if defined(_MSC_VER)
@@ -32,206 +36,24 @@ extern "C" {
 
 #include "camera.h"
 #include "input.h"
-
-float cube_vertices[] = {
-    // pos                normal    uv
-    // +y
-    -0.5, 0.5, -0.5,      0, 1, 0,  0, 1,
-    -0.5, 0.5, 0.5,       0, 1, 0,  1, 1,
-    0.5, 0.5, 0.5,        0, 1, 0,  1, 0,
-    0.5, 0.5, -0.5,       0, 1, 0,  0, 0,
-
-    // -x    
-    -0.5, 0.5, 0.5,       -1, 0, 0, 0, 0,
-    -0.5, -0.5, 0.5,      -1, 0, 0, 0, 1,
-    -0.5, -0.5, -0.5,     -1, 0, 0, 1, 1,
-    -0.5, 0.5, -0.5,      -1, 0, 0, 1, 0,
-
-    // +x
-    0.5, 0.5, 0.5,        1, 0, 0, 0, 0,
-    0.5, -0.5, 0.5,       1, 0, 0, 0, 1,
-    0.5, -0.5, -0.5,      1, 0, 0, 1, 1,
-    0.5, 0.5, -0.5,       1, 0, 0, 1, 0,
-
-    // -z
-    0.5, 0.5, 0.5,        0, 0, -1, 0, 0,
-    0.5, -0.5, 0.5,       0, 0, -1, 0, 1,
-    -0.5, -0.5, 0.5,      0, 0, -1, 1, 1,
-    -0.5, 0.5, 0.5,       0, 0, -1, 1, 0,
-
-    // +z
-    0.5, 0.5, -0.5,       0, 0, 1, 0, 0,
-    0.5, -0.5, -0.5,      0, 0, 1, 0, 1,
-    -0.5, -0.5, -0.5,     0, 0, 1, 1, 1,
-    -0.5, 0.5, -0.5,      0, 0, 1, 1, 0,
-
-    // -y    
-    -0.5, -0.5, -0.5,     0, -1, 0, 0, 1,
-    -0.5, -0.5, 0.5,      0, -1, 0, 1, 1,
-    0.5, -0.5, 0.5,       0, -1, 0, 1, 0,
-    0.5, -0.5, -0.5,      0, -1, 0, 0, 0
-};
-
-uint16_t cube_indices[] = {
-    0, 1, 2,  0, 2, 3,       // +y
-    6, 5, 4,  7, 6, 4,       // -x
-    8, 9, 10,  8, 10, 11,    // +x
-    14, 13, 12,  15, 14, 12, // -z
-    16, 17, 18,  16, 18, 19, // +z
-    22, 21, 20,  23, 22, 20  // -y
-};
-
-struct render_properties {
-    bool wireframe_mode;
-    bool disable_vsync;
-};
-
-struct render {
-    sg_pipeline pip;
-    sg_shader shader;
-    sg_bindings bind;
-    sg_pass_action pass_action;
-
-    ::render_properties previous_properties, properties;
-    ::camera camera;
-};
-
-struct combined_buffer_gpu {
-    sg_buffer vertices;
-    sg_buffer indices;
-    size_t index_count;
-};
-
-struct combined_buffer {
-    size_t stride;
-    size_t vertex_count;
-    size_t index_count;
-    float *vertices;
-    uint16_t *indices;
-};
-
-::combined_buffer init_combined_buffer_malloc(size_t stride, size_t vertex_count, size_t index_count)
-{
-    return (::combined_buffer){stride, 0, 0, (float*)malloc((vertex_count * stride) * sizeof(float)), (uint16_t*)malloc(index_count * sizeof(uint16_t))};
-}
-
-// deinits combined buffer that was allocated with malloc
-void deinit_combined_buffer_malloc(::combined_buffer *buffer)
-{
-    free(buffer->vertices);
-    free(buffer->indices);
-}
-
-::combined_buffer_gpu make_gpu_combined_buffer(::combined_buffer const *buffer, ::render *render)
-{
-    assert(buffer->index_count > 0 && buffer->vertex_count > 0);
-    sg_buffer_desc index_buffer = {};
-    index_buffer.data = sg_range{buffer->indices, buffer->index_count * sizeof *buffer->indices};
-    index_buffer.type = SG_BUFFERTYPE_INDEXBUFFER;
-    index_buffer.label = "cube-indices";
-
-    sg_buffer_desc vertex_buffer = {};
-    vertex_buffer.data = sg_range{buffer->vertices, buffer->vertex_count * buffer->stride * sizeof *buffer->vertices};
-    vertex_buffer.label = "cube-vertices";
-
-    printf("Creating GPU Buffer: i/%zu v/%zu\n", buffer->index_count, buffer->vertex_count);
-
-    return {sg_make_buffer(&vertex_buffer), sg_make_buffer(&index_buffer), buffer->index_count};
-}
-
-// Flags for choosing sides of cube to display
-typedef uint8_t cube_side_flags;
-#define CUBE_SIDE_FLAG_PX 0b1
-#define CUBE_SIDE_FLAG_NX 0b10
-#define CUBE_SIDE_FLAG_PY 0b100
-#define CUBE_SIDE_FLAG_NY 0b1000
-#define CUBE_SIDE_FLAG_PZ 0b10000
-#define CUBE_SIDE_FLAG_NZ 0b100000
-
-struct cube_mesh_cache {
-    combined_buffer_gpu buffer;
-    size_t index_offsets[64];
-    size_t index_sizes[64];
-};
-
-/**
- * @brief      Appends a cube quad to combined buffer.
- *
- * @param      buffer   The combined buffer
- * @param[in]  quad_no  The quad number (check the vertex buffer constant above)
- */
-void append_cube_quad_to_combined_buffer(::combined_buffer *buffer, size_t quad_no)
-{
-    // assert that the vertex buffer is trivially copyable
-    assert(buffer->stride == 8);
-    assert(buffer->index_count % 6 == 0);
-
-    const size_t
-        output_vertex_offset = buffer->vertex_count * buffer->stride,
-        output_index_offset = buffer->index_count,
-        output_quad_no = buffer->index_count / 6,
-        input_vertex_offset = quad_no * 4 * buffer->stride,
-        input_index_offset = quad_no * 6;
-
-    memcpy(buffer->vertices + output_vertex_offset, cube_vertices + input_vertex_offset, buffer->stride * sizeof(float) * 4);
-    memcpy(buffer->indices + output_index_offset, cube_indices + input_index_offset, sizeof(uint16_t) * 6);
-
-    for (size_t i = output_index_offset; i < output_index_offset+6; ++i) {
-        buffer->indices[i] -= quad_no * 4; // transform to relative
-        buffer->indices[i] += output_quad_no * 4; // transform to absolute in output buffer
-    }
-
-    buffer->index_count += 6;
-    buffer->vertex_count += 4;
-}
-
-/**
- * @brief      Initializes the cube mesh cache with each permutation of a cube in it.
- *
- * @return     The cache
- */
-::cube_mesh_cache init_cube_mesh_cache(::render *render)
-{
-    ::cube_mesh_cache output = {};
-    ::combined_buffer buffer = init_combined_buffer_malloc(8, 4*64*6, 6*64*6);
-
-    for (cube_side_flags flags = 1; flags < 64; ++flags) {
-        size_t start_index_offset = buffer.index_count;
-
-        if (flags & CUBE_SIDE_FLAG_PY) {
-            append_cube_quad_to_combined_buffer(&buffer, 0);
-        }
-        if (flags & CUBE_SIDE_FLAG_NX) {
-            append_cube_quad_to_combined_buffer(&buffer, 1);
-        }
-        if (flags & CUBE_SIDE_FLAG_PX) {
-            append_cube_quad_to_combined_buffer(&buffer, 2);
-        }
-        if (flags & CUBE_SIDE_FLAG_PZ) {
-            append_cube_quad_to_combined_buffer(&buffer, 3);
-        }
-        if (flags & CUBE_SIDE_FLAG_NZ) {
-            append_cube_quad_to_combined_buffer(&buffer, 4);
-        }
-        if (flags & CUBE_SIDE_FLAG_NY) {
-            append_cube_quad_to_combined_buffer(&buffer, 5);
-        }
-
-        output.index_offsets[flags] = start_index_offset;
-        output.index_sizes[flags] = buffer.index_count-start_index_offset;
-    }
-
-    output.buffer = make_gpu_combined_buffer(&buffer, render);
-
-    return output;
-}
-
-void uninit_cube_mesh_cache(::cube_mesh_cache *cmc) 
-{
-    // FIXME(skejeton): I should ideally move destruction code to operate on the gpu combined buffer itself
-    sg_destroy_buffer(cmc->buffer.indices);
-    sg_destroy_buffer(cmc->buffer.vertices);
-}
+#include "input_record.h"
+#include "simulation.h"
+#include "mesh.h"
+#include "world.h"
+#include "chunk_mesh.h"
+#include "face_mask.h"
+#include "frustum.h"
+#include "jobs.h"
+#include "render.h"
+#include "profiler.h"
+#include "frame_history.h"
+
+// Where "Save trace" writes to, open it in chrome://tracing or ui.perfetto.dev
+#define PROFILER_TRACE_PATH "trace.json"
+// Where "Record input" writes to and "Replay input" reads from
+#define INPUT_RECORD_PATH "input.ctin"
+// How far away blocks can be edited, in blocks
+#define BLOCK_EDIT_REACH 64.0f
 
 static void set_rounding(float rounding)
 {
@@ -242,28 +64,10 @@ static void set_rounding(float rounding)
     ImGui::GetStyle().WindowRounding = rounding;
 }
 
-void init_render_pipeline(::render *render)
+// The swap interval belongs to the window, not to sokol_gfx
+static void apply_vsync(::render_properties const &properties)
 {
-    /* create a pipeline object (default render states are fine for triangle) */
-    sg_pipeline_desc pipeline_desc = {};
-
-    /* if the vertex layout doesn't have gaps, don't need to provide strides and offsets */
-    pipeline_desc.shader = render->shader;
-    pipeline_desc.label = "cube-pipeline";
-    pipeline_desc.layout.buffers[0].stride = 4*8;
-    pipeline_desc.index_type = SG_INDEXTYPE_UINT16;
-    pipeline_desc.layout.attrs[ATTR_vs_position].format = SG_VERTEXFORMAT_FLOAT3;
-    pipeline_desc.layout.attrs[ATTR_vs_normal].format = SG_VERTEXFORMAT_FLOAT3;
-    pipeline_desc.layout.attrs[ATTR_vs_uv].format = SG_VERTEXFORMAT_FLOAT2;
-    pipeline_desc.depth.write_enabled = true;
-    pipeline_desc.depth.compare = SG_COMPAREFUNC_LESS_EQUAL;
-    pipeline_desc.cull_mode = SG_CULLMODE_FRONT;
-    if (render->properties.wireframe_mode) {
-        pipeline_desc.primitive_type = SG_PRIMITIVETYPE_LINE_STRIP;
-    } else {
-        pipeline_desc.primitive_type = SG_PRIMITIVETYPE_TRIANGLES;
-    }
-    if (render->properties.disable_vsync) {
+    if (properties.disable_vsync) {
         // disable fps cap
 #ifdef SOKOL_GLCORE33 
         _sapp_glx_swapinterval(0);
@@ -273,443 +77,372 @@ void init_render_pipeline(::render *render)
     } else {
         _sapp_glx_swapinterval(1);
     }
-
-    if (render->pip.id == 0) { // init new
-        render->pip = sg_make_pipeline(&pipeline_desc);
-    } else { // recreate
-        sg_uninit_pipeline(render->pip);
-        sg_init_pipeline(render->pip, &pipeline_desc);
-    }
-
-    printf("Created new pipeline %d\n", render->pip.id);
 }
 
-void flush_render_pipeline(::render *render)
-{
-    // check if there's a reason to re initialize
-    if (memcmp(&render->previous_properties, &render->properties, sizeof render->properties) == 0) {
-        return;
-    }
-
-    render->previous_properties = render->properties;
+static const char *chunk_draw_mode_names[CHUNK_DRAW_MODE_COUNT] = {"Baked chunks", "Instanced voxels", "Per voxel"};
+static const char *chunk_mesh_mode_names[CHUNK_MESH_MODE_COUNT] = {"Per face", "Greedy"};
 
-    init_render_pipeline(render);
-}
-
-////////////
-// Render
-::render init_render()
-{
-    ::render state = {};
-    sg_desc desc = {};
-    desc.context = sapp_sgcontext();
-    sg_setup(&desc);
-
-    sg_buffer_desc index_buffer = {};
-    index_buffer.data = SG_RANGE(cube_indices);
-    index_buffer.type = SG_BUFFERTYPE_INDEXBUFFER;
-    index_buffer.label = "cube-indices";
-
-    sg_buffer_desc buffer_desc = {};
-    buffer_desc.data = SG_RANGE(cube_vertices);
-    buffer_desc.label = "cube-vertices";
-
-    state.bind.index_buffer = sg_make_buffer(&index_buffer);
-    state.bind.vertex_buffers[0] = sg_make_buffer(&buffer_desc);
-
-    /* create shader from code-generated sg_shader_desc */
-    state.shader = sg_make_shader(cube_shader_desc(sg_query_backend()));
-
-    init_render_pipeline(&state);
-
-    /* a pass action to framebuffer to black */
-    state.pass_action = {};
-    state.pass_action.colors[0] = { .action=SG_ACTION_CLEAR, .value={0.0f, 0.0f, 0.0f, 1.0f } };
-
-    state.camera = camera::init(45);
-    return state;
-}
-
-void begin_render(::render *render) {
-    flush_render_pipeline(render);
-    sg_begin_default_pass(render->pass_action, sapp_width(), sapp_height());
-}
+///////////
+// State
+struct state {
+    float bg_color[3];
+    bool wireframe_mode;
 
-void end_render(::render *render) {
-    sg_end_pass();
-    sg_commit();
-}
+    ::render render;
+    ::input input;
+    ::world world;
+    ::cube_mesh_cache cube_mesh_cache;
+    ::chunk_draw_mode chunk_draw_mode;
+    ::chunk_mesh_mode chunk_mesh_mode;
+    ::world_visible_chunks visible_chunks;
+
+    ::job_system jobs;
+    ::chunk_mesh_uploads chunk_mesh_uploads;
+    ::frame_history frame_history;
+
+    // Moves the camera in fixed ticks, render.camera is drawn between them
+    ::simulation simulation;
+
+    ::input_recorder input_recorder;
+    ::input_replay input_replay;
+    // Quits once the replay is over, for replays given on the command line
+    bool quit_after_replay;
+    // Waits for every chunk job of a replayed frame within the frame, so each replay loads the same chunks
+    // in the same frames. Frame times then include the waits.
+    bool replay_drain_jobs;
+    // Taken from the window, or from the recording while replaying
+    bool mouse_locked;
+    float aspect;
+    // Seconds this frame stands for, fixed by the recording while replaying
+    float frame_duration;
+
+    // Time spent per frame moving generated chunks into the world, and on uploading meshes
+    float streaming_budget_ms;
+
+    // The last block edit, from set_block until its chunks are rebaked and uploaded
+    float edit_us;
+    int edit_chunks;
+};
 
-void set_bgcolor(::render *render, float color[3])
-{
-    render->pass_action.colors[0].value = sg_color{color[0], color[1], color[2], 1.0};
-}
+static ::state GLOBAL_state;
+// From the command line, started once the app is up
+static char const *GLOBAL_record_path;
+static char const *GLOBAL_replay_path;
 
-void draw_cube_flags(::render *render, cube_side_flags flags)
+void handle_camera(::state *state)
 {
-    // FIXME(skejeton): this is a shit way to draw it
-    if (flags & CUBE_SIDE_FLAG_PY) {
-        sg_draw(0, 6, 1);
-    }
-    if (flags & CUBE_SIDE_FLAG_NX) {
-        sg_draw(6, 6, 1);
-    }
-    if (flags & CUBE_SIDE_FLAG_PX) {
-        sg_draw(12, 6, 1);
-    }
-    if (flags & CUBE_SIDE_FLAG_PZ) {
-        sg_draw(18, 6, 1);
-    }
-    if (flags & CUBE_SIDE_FLAG_NZ) {
-        sg_draw(24, 6, 1);
-    }
-    if (flags & CUBE_SIDE_FLAG_NY) {
-        sg_draw(30, 6, 1);
+    PROFILE_FUNCTION();
+    // A replay brings its own mouse lock and aspect, the window is left alone
+    if (!state->input_replay.data) {
+        if (state->input.key_states[SAPP_KEYCODE_ESCAPE].pressed) {
+            sapp_lock_mouse(false);
+        }
+        if (state->input.mouse_states[SAPP_MOUSEBUTTON_LEFT].pressed) {
+            sapp_lock_mouse(true);
+        }
+        state->mouse_locked = sapp_mouse_locked();
+        state->aspect = sapp_widthf()/sapp_heightf();
     }
-
+    // Reset imgui rotations (HACK?)
+    state->simulation.camera.rotate({0, 0});
+    advance_simulation(&state->simulation, state->input, state->mouse_locked, state->frame_duration);
+    state->render.camera = get_simulation_camera(&state->simulation, state->aspect);
 }
 
-void draw_cube(::render *render, hmm_vec3 pos, cube_side_flags flags)
+// Removes the block in the middle of the screen on a right click, a middle click places one against it.
+// Called right after update_world_meshes took every other outdated chunk, so only the chunks the edit
+// outdated are rebaked, and they are uploaded within the same frame.
+static void edit_world_block(::state *state)
 {
-    if (flags == 0) {
+    bool remove = state->input.mouse_states[SAPP_MOUSEBUTTON_RIGHT].pressed;
+    bool place = state->input.mouse_states[SAPP_MOUSEBUTTON_MIDDLE].pressed;
+    if (!state->mouse_locked || !(remove || place)) {
         return;
     }
-    hmm_mat4 m_m = HMM_Translate(pos);
-    hmm_mat4 mvp = render->camera.get_vp() * m_m;
-
-    vs_params_t params = {};
-    memcpy(params.mvp, mvp.Elements, sizeof mvp.Elements);
-    auto params_range = SG_RANGE(params);
-
-    // DRAW USER STUFF
-    sg_apply_pipeline(render->pip);
-    sg_apply_bindings(&render->bind);
-    sg_apply_uniforms(SG_SHADERSTAGE_VS, SLOT_vs_params, &params_range);
-
-    draw_cube_flags(render, flags);
-}
-
-void handle_camera_input(::render *render, ::input const &input)
-{
-    ::camera *camera = &render->camera;
-
-    // FIXME(skejeton): LEAKING INPUT.H API!
-    camera->rotate(hmm_vec2{input.mouse_delta.Y/4, -input.mouse_delta.X/4});
-
-    if (input.key_states[SAPP_KEYCODE_LEFT_SHIFT].held) {
-        camera->move(0, 0, -1);
-    }
+    PROFILE_FUNCTION();
 
-    if (input.key_states[SAPP_KEYCODE_SPACE].held) {
-        camera->move(0, 0, 1);
-    }
-
-    if (input.key_states[SAPP_KEYCODE_W].held) {
-        camera->move(1, 0, 0);
-    }
-
-    if (input.key_states[SAPP_KEYCODE_S].held) {
-        camera->move(-1, 0, 0);
-    }
-
-    if (input.key_states[SAPP_KEYCODE_A].held) {
-        camera->move(0, 1, 0);
+    ::camera *camera = &state->render.camera;
+    vec3i hit, before;
+    if (!raycast_block(&state->world, camera->position, camera->get_direction(), BLOCK_EDIT_REACH, &hit, &before)) {
+        return;
     }
 
-    if (input.key_states[SAPP_KEYCODE_D].held) {
-        camera->move(0, -1, 0);
+    auto start = std::chrono::steady_clock::now();
+    if (!set_block(&state->world, remove ? hit : before, place)) {
+        return;
     }
+    ::job_counter counter = {};
+    ::chunk_mesh_uploads edited = {};
+    bool instanced = state->chunk_draw_mode == CHUNK_DRAW_MODE_INSTANCED;
+    update_world_meshes(&state->world, &edited, &state->jobs, state->chunk_mesh_mode, instanced, &counter);
+    wait_for_counter(&state->jobs, &counter);
+    state->edit_chunks = upload_world_meshes(&state->render, &edited, INFINITY);
+    state->edit_us = std::chrono::duration<float, std::micro>(std::chrono::steady_clock::now() - start).count();
 }
 
-#define CHUNK_SIZE 32
-#define RENDER_DISTANCE 6
-
-struct chunk {
-    //        x   y   z
-    bool data[CHUNK_SIZE][CHUNK_SIZE][CHUNK_SIZE]; // true = block set, false = no block
-    cube_side_flags mesh_map[CHUNK_SIZE][CHUNK_SIZE][CHUNK_SIZE];
-    bool dirty;
-};
-
-struct vec3i {
-    int x, y, z;
-
-    static vec3i from(hmm_vec3 v) {
-        return {int(v.X), int(v.Y), int(v.Z)};
-    }
-};
-
-vec3i operator%(vec3i v, int val)
+static void start_input_recording(::state *state, char const *path)
 {
-    return {v.x%val, v.y%val, v.z%val};
-}
-
-vec3i operator+(vec3i v, vec3i u)
-{
-    return {v.x+u.x, v.y+u.y, v.z+u.z};
-}
-
-vec3i operator+(vec3i v, int u)
-{
-    return {v.x+u, v.y+u, v.z+u};
-}
-
-vec3i operator-(vec3i v, vec3i u)
-{
-    return {v.x-u.x, v.y-u.y, v.z-u.z};
+    end_input_recording(&state->input_recorder);
+    // The replay starts from a tick, with nothing left over from earlier frames
+    init_simulation(&state->simulation, &state->simulation.camera, state->simulation.tick_rate);
+    if (begin_input_recording(&state->input_recorder, path, &state->simulation.camera, state->simulation.tick_rate)) {
+        printf("Input recording: recording to %s\n", path);
+    }
 }
 
-vec3i operator-(vec3i v, int u)
+static void stop_input_recording(::state *state)
 {
-    return {v.x-u, v.y-u, v.z-u};
+    if (state->input_recorder.file) {
+        printf("Input recording: %llu frames recorded\n", (unsigned long long)state->input_recorder.frame_count);
+    }
+    end_input_recording(&state->input_recorder);
 }
 
-vec3i operator*(vec3i v, int u)
+// Flies the camera from where the recording started
+static void start_input_replay(::state *state, char const *path)
 {
-    return {v.x*u, v.y*u, v.z*u};
+    stop_input_recording(state);
+    unload_input_replay(&state->input_replay);
+    if (load_input_replay(&state->input_replay, path)) {
+        printf("Input replay: replaying %s\n", path);
+        ::camera camera = state->simulation.camera;
+        camera.position = state->input_replay.camera_position;
+        camera.yaw_pitch = state->input_replay.camera_yaw_pitch;
+        camera.dirty = true;
+        init_simulation(&state->simulation, &camera, state->input_replay.tick_rate);
+    }
 }
 
-vec3i operator*(vec3i v, vec3i u)
+static void stop_input_replay(::state *state)
 {
-    return {v.x*u.x, v.y*u.y, v.z*u.z};
-}
+    if (!state->input_replay.data) {
+        return;
+    }
 
-bool operator==(vec3i v, vec3i u)
-{
-    return v.x == u.x && v.y == u.y && v.z == u.z;
+    ::frame_time_lows lows = get_frame_time_lows(&state->frame_history);
+    printf("Input replay: %llu frames replayed, average %.2f ms, 1%% low %.2f ms, 0.1%% low %.2f ms\n",
+        (unsigned long long)state->input_replay.frame_count, lows.average_ms, lows.low_1_ms, lows.low_01_ms);
+    unload_input_replay(&state->input_replay);
+    // Keys held in the recording would stay held otherwise
+    state->input = {};
+    if (state->quit_after_replay) {
+        sapp_request_quit();
+    }
 }
 
-bool vec3i_check_bounds(vec3i v, vec3i p1, vec3i p2)
+// Swaps the live input for the next recorded frame while replaying
+static void begin_input_frame(::state *state)
 {
-    return v.x >= p1.x && v.y >= p1.y && v.z >= p1.z && v.x < p2.x && v.y < p2.y && v.z < p2.z;
-}
+    state->frame_duration = (float)sapp_frame_duration();
+    if (!state->input_replay.data) {
+        return;
+    }
 
-int vec3i_dot(vec3i v, vec3i u)
-{
-    return v.x*u.x+v.y*u.y+v.z*u.z;
+    ::input_frame frame;
+    if (!replay_input_frame(&state->input_replay, &frame)) {
+        stop_input_replay(state);
+        return;
+    }
+    state->input = frame.input;
+    state->mouse_locked = frame.mouse_locked;
+    state->aspect = frame.aspect;
+    state->frame_duration = frame.duration;
 }
 
-///////////
-// World 
-struct world {
-    ::chunk *chunks[RENDER_DISTANCE][RENDER_DISTANCE][RENDER_DISTANCE];
-    vec3i chunk_offset; 
-};
-
-#define WORLD_ITER(x, y, z) for (int x = 0; x < RENDER_DISTANCE; ++x) for (int y = 0; y < RENDER_DISTANCE; ++y) for (int z = 0; z < RENDER_DISTANCE; ++z)
-#define CHUNK_ITER(x, y, z) for (int x = 0; x < CHUNK_SIZE; ++x) for (int y = 0; y < CHUNK_SIZE; ++y) for (int z = 0; z < CHUNK_SIZE; ++z)
-
-///////////
-// State
-struct state {
-    float bg_color[3];
-    bool wireframe_mode;
-
-    ::render render;
-    ::input input;
-    ::world world;
-    ::cube_mesh_cache cube_mesh_cache;
-};
-
-static ::state GLOBAL_state;
-
-void handle_camera(::state *state)
+static void record_input(::state *state)
 {
-    if (state->input.key_states[SAPP_KEYCODE_ESCAPE].pressed) {
-        sapp_lock_mouse(false);
-    }
-    if (state->input.mouse_states[SAPP_MOUSEBUTTON_LEFT].pressed) {
-        sapp_lock_mouse(true);
-    }
-    if (sapp_mouse_locked()) {
-        handle_camera_input(&state->render, state->input);
+    if (!state->input_recorder.file) {
+        return;
     }
 
-    state->render.camera.set_aspect(sapp_widthf()/sapp_heightf());
-    // Reset imgui rotations (HACK?)
-    state->render.camera.rotate({0, 0});
+    ::input_frame frame = {state->input, state->mouse_locked, state->aspect, state->frame_duration};
+    record_input_frame(&state->input_recorder, &frame);
 }
 
-static bool check_block_chunk(::chunk const *chunk, vec3i pos)
+static void init(void)
 {
-    // FIXME(skejeton): hack
-    if (pos.x < 0 || pos.y < 0 || pos.z < 0) {
-        return false;
-    }
-    return chunk->data[pos.x][pos.y][pos.z];
-}
+    set_profiler_thread_name("Main");
+    init_frame_history(&GLOBAL_state.frame_history);
+    GLOBAL_state.render = init_render(sapp_sgcontext(), cube_shader_desc(sg_query_backend()), chunk_shader_desc(sg_query_backend()), voxel_shader_desc(sg_query_backend()));
+    apply_vsync(GLOBAL_state.render.properties);
+    init_simulation(&GLOBAL_state.simulation, &GLOBAL_state.render.camera, SIMULATION_DEFAULT_TICK_RATE);
+    GLOBAL_state.cube_mesh_cache = init_cube_mesh_cache(&GLOBAL_state.render);
+    init_world(&GLOBAL_state.world);
+    init_job_system(&GLOBAL_state.jobs, 0);
+    GLOBAL_state.streaming_budget_ms = 2;
+    printf("Job system: %d workers\n", GLOBAL_state.jobs.worker_count);
+    printf("Face mask kernel: %s\n", cpu_isa_names[get_cpu_isa(&face_mask_kernels)]);
+    printf("Frustum culling kernel: %s\n", cpu_isa_names[get_cpu_isa(&frustum_cull_kernels)]);
 
-static ::chunk* get_world_chunk(::world const *world, vec3i pos)
-{
-    if (pos.x < 0 || pos.y < 0 || pos.z < 0 || pos.x >= RENDER_DISTANCE*CHUNK_SIZE || pos.y >= RENDER_DISTANCE*CHUNK_SIZE || pos.z >= RENDER_DISTANCE*CHUNK_SIZE) {
-        return nullptr;
+    if (GLOBAL_replay_path) {
+        GLOBAL_state.quit_after_replay = true;
+        start_input_replay(&GLOBAL_state, GLOBAL_replay_path);
+    } else if (GLOBAL_record_path) {
+        start_input_recording(&GLOBAL_state, GLOBAL_record_path);
     }
-    return world->chunks[pos.x/CHUNK_SIZE][pos.y/CHUNK_SIZE][pos.z/CHUNK_SIZE];
+
+    simgui_desc_t simgui_desc = { };
+    simgui_setup(&simgui_desc);
+    ImGui::GetIO().ConfigFlags |= ImGuiConfigFlags_DockingEnable;
+    set_rounding(3);
 }
 
-static bool check_block(::world const *world, vec3i pos)
+// Same zone, same color in every frame
+static ImU32 get_zone_color(char const *name)
 {
-    ::chunk *chunk = get_world_chunk(world, pos);
-    if (chunk) {
-        return check_block_chunk(chunk, pos%CHUNK_SIZE);
+    uint32_t hash = 2166136261u;
+    for (char const *c = name; *c; ++c) {
+        hash = (hash ^ (uint8_t)*c) * 16777619u;
     }
-    return false;
+    return IM_COL32(96 + hash % 128, 96 + (hash >> 8) % 128, 96 + (hash >> 16) % 128, 255);
 }
 
-static cube_side_flags get_side_flags(::world const *world, vec3i pos)
+// Draws the frame time of every frame in the history, clicking a frame selects it
+static void frame_history_plot(::frame_history const *history, ::frame_time_lows lows, uint64_t *selected_frame)
 {
-    cube_side_flags output = 0;
-    const static vec3i neighbours[6] = {{1, 0, 0}, {-1, 0, 0}, {0, 1, 0}, {0, -1, 0}, {0, 0, 1}, {0, 0, -1}};
+    size_t count = get_frame_history_count(history);
+    ImVec2 size = {ImGui::GetContentRegionAvail().x, 120};
+    ImVec2 origin = ImGui::GetCursorScreenPos();
+    ImGui::InvisibleButton("Frame times", size);
+    bool clicked = ImGui::IsItemClicked();
+    bool hovered = ImGui::IsItemHovered();
 
-    int i = 0;
-    for (auto neighbor : neighbours) {
-        output = output | ((cube_side_flags)(!check_block(world, pos+neighbor)) << i);
-        i++;
+    ImDrawList *draw_list = ImGui::GetWindowDrawList();
+    draw_list->AddRectFilled(origin, {origin.x+size.x, origin.y+size.y}, IM_COL32(20, 20, 20, 255));
+    if (count == 0 || size.x < 1) {
+        return;
     }
 
-    return output;
-}
+    // Leave room above the 0.1% low, but always show the 30 FPS line
+    float scale_ms = HMM_MAX(lows.low_01_ms*1.25f, 1000.0f/30);
+    int columns = (int)size.x;
+    int mouse_column = (int)(ImGui::GetMousePos().x - origin.x);
 
-void generate_world_mesh_map(::world *world) 
-{
-    WORLD_ITER(i, j, k) {
-        ::chunk *chunk = world->chunks[i][j][k];
-        if (chunk && chunk->dirty) {
-            // TODO(skejeton): the dirty bit might be reset somewhere else
-            chunk->dirty = false;
-
-            CHUNK_ITER(x, y, z) {
-                chunk->mesh_map[x][y][z] = get_side_flags(world, {x+i*CHUNK_SIZE, y+j*CHUNK_SIZE, z+k*CHUNK_SIZE});
+    for (int column = 0; column < columns; ++column) {
+        // One column per pixel shows the slowest of its frames, so single frame spikes stay visible
+        size_t first_age = (size_t)(columns-1-column) * count / columns;
+        size_t last_age = HMM_MAX((size_t)(columns-column) * count / columns, first_age+1);
+        size_t slowest_age = first_age;
+        for (size_t age = first_age; age < last_age; ++age) {
+            if (get_frame_history_record(history, age)->duration_ms > get_frame_history_record(history, slowest_age)->duration_ms) {
+                slowest_age = age;
             }
         }
-    }
-}
-
-::chunk generate_chunk(vec3i chunk)
-{
-    ::chunk output = {};
-    output.dirty = true;
 
-    CHUNK_ITER(x, y, z) {
-        vec3i block_pos = chunk * CHUNK_SIZE + vec3i{x, y, z}; 
+        float duration_ms = get_frame_history_record(history, slowest_age)->duration_ms;
+        float height = HMM_MIN(duration_ms/scale_ms, 1.0f) * size.y;
+        uint64_t frame = history->frame_count-1-slowest_age;
+        ImU32 color = duration_ms > lows.low_1_ms ? IM_COL32(230, 90, 60, 255) : IM_COL32(90, 200, 110, 255);
+        if (frame == *selected_frame) {
+            color = IM_COL32(255, 255, 255, 255);
+        }
+        draw_list->AddLine({origin.x+column+0.5f, origin.y+size.y}, {origin.x+column+0.5f, origin.y+size.y-height}, color);
 
-        if (block_pos == vec3i{0, 0, 0}) {
-            output.data[x][y][z] = 1;
+        if (column == mouse_column && hovered) {
+            ImGui::SetTooltip("Frame %llu: %.2f ms", (unsigned long long)frame, duration_ms);
+            if (clicked) {
+                *selected_frame = frame;
+            }
         }
     }
 
-    return output;
-}
-
-void put_world_chunk(::world *world, vec3i relative_chunk_pos, ::chunk *chunk)
-{
-    if (vec3i_check_bounds(relative_chunk_pos, {0, 0, 0}, {RENDER_DISTANCE, RENDER_DISTANCE, RENDER_DISTANCE})) {
-        world->chunks[relative_chunk_pos.x][relative_chunk_pos.y][relative_chunk_pos.z] = chunk;
+    struct { float ms; char const *label; ImU32 color; } markers[] = {
+        {1000.0f/60, "60 FPS", IM_COL32(120, 120, 120, 255)},
+        {lows.low_1_ms, "1% low", IM_COL32(240, 200, 60, 255)},
+        {lows.low_01_ms, "0.1% low", IM_COL32(240, 80, 60, 255)},
+    };
+    for (auto const &marker : markers) {
+        float y = origin.y + size.y - HMM_MIN(marker.ms/scale_ms, 1.0f) * size.y;
+        draw_list->AddLine({origin.x, y}, {origin.x+size.x, y}, marker.color);
+        draw_list->AddText({origin.x+2, y-ImGui::GetTextLineHeight()}, marker.color, marker.label);
     }
 }
 
-void change_world_chunk_offset(::world *world, vec3i new_chunk_offset)
+// Draws the zones of a frame, each nesting level on its own row
+static void frame_flame_graph(::frame_record const *frame)
 {
-    // Avoid waste of time
-    if (world->chunk_offset == new_chunk_offset) {
-        return;
+    int max_depth = 0;
+    float span_ms = frame->duration_ms;
+    for (size_t i = 0; i < frame->zone_count; ++i) {
+        max_depth = HMM_MAX(max_depth, frame->zones[i].depth);
+        span_ms = HMM_MAX(span_ms, frame->zones[i].begin_ms + frame->zones[i].duration_ms);
     }
 
-    vec3i delta = new_chunk_offset-world->chunk_offset;
-
-    decltype(world->chunks) original_chunks;
-    memcpy(original_chunks, world->chunks, sizeof original_chunks);
+    float row_height = ImGui::GetTextLineHeight() + 4;
+    ImVec2 size = {ImGui::GetContentRegionAvail().x, (max_depth+1) * row_height};
+    ImVec2 origin = ImGui::GetCursorScreenPos();
+    ImGui::InvisibleButton("Flame graph", size);
+    bool hovered = ImGui::IsItemHovered();
+    ImVec2 mouse = ImGui::GetMousePos();
 
-    // Invalidate chunks
-    WORLD_ITER(i, j, k) {
-        world->chunks[i][j][k] = nullptr;
-    }
+    ImDrawList *draw_list = ImGui::GetWindowDrawList();
+    for (size_t i = 0; i < frame->zone_count; ++i) {
+        ::frame_zone const *zone = &frame->zones[i];
+        ImVec2 min = {origin.x + zone->begin_ms/span_ms*size.x, origin.y + zone->depth*row_height};
+        ImVec2 max = {HMM_MAX(origin.x + (zone->begin_ms+zone->duration_ms)/span_ms*size.x, min.x+1), min.y + row_height - 1};
 
-    // Move chunks
-    WORLD_ITER(i, j, k) {
-        put_world_chunk(world, vec3i{i, j, k} - delta, original_chunks[i][j][k]);
+        draw_list->AddRectFilled(min, max, get_zone_color(zone->name));
+        if (ImGui::CalcTextSize(zone->name).x < max.x-min.x-4) {
+            draw_list->AddText({min.x+2, min.y+2}, IM_COL32(0, 0, 0, 255), zone->name);
+        }
+        if (hovered && mouse.x >= min.x && mouse.x < max.x && mouse.y >= min.y && mouse.y < max.y) {
+            ImGui::SetTooltip("%s: %.3f ms", zone->name, zone->duration_ms);
+        }
     }
-
-    world->chunk_offset = new_chunk_offset;
 }
 
-void change_world_chunk_offset_relative_to_camera(::world *world, camera *cam)
-{
-    change_world_chunk_offset(world, vec3i::from(cam->position/CHUNK_SIZE));
-} 
-
-void generate_world(::world *world)
+// Lists the zones that took the most time themselves, not counting the zones inside them
+static void frame_slowest_zones(::frame_record const *frame)
 {
-    WORLD_ITER(i, j, k) {
-        vec3i chunk_pos = vec3i{i, j, k} - (RENDER_DISTANCE/2) + world->chunk_offset;
-        vec3i sphere_coords = vec3i{i, j, k} - (RENDER_DISTANCE/2);
-
-        // Only generate chunks in sphere
-        if (vec3i_dot(sphere_coords, sphere_coords) < RENDER_DISTANCE/2*RENDER_DISTANCE/2) {
-            // To not regenerate chunk after it's created
-            if (world->chunks[i][j][k] == nullptr) {
-                world->chunks[i][j][k] = (::chunk*)malloc(sizeof(::chunk));
-                *world->chunks[i][j][k] = generate_chunk(chunk_pos);
+    float self_ms[FRAME_HISTORY_MAX_ZONES];
+    size_t order[FRAME_HISTORY_MAX_ZONES];
+    for (size_t i = 0; i < frame->zone_count; ++i) {
+        self_ms[i] = frame->zones[i].duration_ms;
+        // Zones are sorted by start, so the ones inside follow right after
+        for (size_t j = i+1; j < frame->zone_count && frame->zones[j].depth > frame->zones[i].depth; ++j) {
+            if (frame->zones[j].depth == frame->zones[i].depth+1) {
+                self_ms[i] -= frame->zones[j].duration_ms;
             }
         }
+        order[i] = i;
     }
-    generate_world_mesh_map(world);
-}
+    std::sort(order, order + frame->zone_count, [&self_ms](size_t a, size_t b) { return self_ms[a] > self_ms[b]; });
 
-
-void draw_world(::render *render, ::cube_mesh_cache *cube_mesh_cache, ::world const &world)
-{
-    // DRAW USER STUFF
-    vs_params_t params = {};
-    auto params_range = SG_RANGE(params);
-    sg_apply_pipeline(render->pip);
-    sg_apply_bindings(&render->bind);
-
-    // FIXME(skejeton): I should move it somewhere else
-    render->bind.index_buffer = cube_mesh_cache->buffer.indices;
-    render->bind.vertex_buffers[0] = cube_mesh_cache->buffer.vertices;
-
-    WORLD_ITER(i, j, k) {
-        ::chunk const *chunk = world.chunks[i][j][k];
-        vec3i chunk_pos = vec3i{i, j, k} - (RENDER_DISTANCE/2) + world.chunk_offset;
-
-        if (chunk) {
-            CHUNK_ITER(x, y, z) {
-                if (chunk->data[x][y][z]) {
-                    cube_side_flags flags = chunk->mesh_map[x][y][z];
-                    if (flags == 0) {
-                        continue;
-                    }
-                    if (flags > 0b111111) {
-                        fprintf(stderr, "INVALID FLAGS!\n");
-                    }
-                    hmm_mat4 m_m = HMM_Translate({float(x+chunk_pos.x*CHUNK_SIZE), float(y+chunk_pos.y*CHUNK_SIZE), float(z+chunk_pos.z*CHUNK_SIZE)});
-                    hmm_mat4 mvp = render->camera.get_vp() * m_m;
-
-                    memcpy(params.mvp, mvp.Elements, sizeof mvp.Elements);
-                    sg_apply_uniforms(SG_SHADERSTAGE_VS, SLOT_vs_params, &params_range);
-
-
-                    sg_draw(cube_mesh_cache->index_offsets[flags], cube_mesh_cache->index_sizes[flags], 1);
-                }
-            }
-        }
+    for (size_t i = 0; i < frame->zone_count && i < 5; ++i) {
+        ::frame_zone const *zone = &frame->zones[order[i]];
+        ImGui::TextColored(ImGui::ColorConvertU32ToFloat4(get_zone_color(zone->name)), "%8.3f ms  %s", self_ms[order[i]], zone->name);
     }
 }
 
-static void init(void)
+static void frame_history_window(::frame_history const *history, bool *open)
 {
-    GLOBAL_state.render = init_render();
-    GLOBAL_state.cube_mesh_cache = init_cube_mesh_cache(&GLOBAL_state.render);
+    static uint64_t selected_frame = UINT64_MAX;
+    ::frame_time_lows lows = get_frame_time_lows(history);
 
-    simgui_desc_t simgui_desc = { };
-    simgui_setup(&simgui_desc);
-    ImGui::GetIO().ConfigFlags |= ImGuiConfigFlags_DockingEnable;
-    set_rounding(3);
+    ImGui::Begin("Frame history", open);
+        ImGui::Text("Average %.2f ms, 1%% low %.2f ms (%.0f FPS), 0.1%% low %.2f ms (%.0f FPS)",
+            lows.average_ms, lows.low_1_ms, 1000/HMM_MAX(lows.low_1_ms, 0.001f), lows.low_01_ms, 1000/HMM_MAX(lows.low_01_ms, 0.001f));
+        frame_history_plot(history, lows, &selected_frame);
+
+        size_t count = get_frame_history_count(history);
+        if (selected_frame < history->frame_count && history->frame_count - 1 - selected_frame < count) {
+            ::frame_record const *frame = get_frame_history_record(history, history->frame_count - 1 - selected_frame);
+            ImGui::Text("Frame %llu: %.2f ms", (unsigned long long)selected_frame, frame->duration_ms);
+            if (frame->zone_count == 0) {
+                ImGui::Text("No zones recorded in this frame, turn on \"Record profile\"");
+            } else {
+                frame_flame_graph(frame);
+                frame_slowest_zones(frame);
+            }
+        } else {
+            ImGui::Text("Click a frame to see where its time went");
+        }
+    ImGui::End();
 }
 
 static void ui(void)
 {
+    PROFILE_FUNCTION();
 
     simgui_new_frame({sapp_width(), sapp_height(), sapp_frame_duration(), sapp_dpi_scale()});
 
@@ -727,14 +460,44 @@ static void ui(void)
             char buf[256];
             snprintf(buf, 256, "FPS: %.1f\n", ImGui::GetIO().Framerate);
             ImGui::Button(buf);
+            ::chunk_pool const *pool = &GLOBAL_state.world.chunk_pool;
+            snprintf(buf, 256, "Chunks: %zu/%zu (peak %zu)\n", get_chunk_pool_occupancy(pool), pool->capacity, pool->high_water_mark);
+            ImGui::Button(buf);
+            size_t stages[CHUNK_STAGE_COUNT];
+            get_world_stage_counts(&GLOBAL_state.world, stages);
+            int length = snprintf(buf, 256, "Stages:");
+            for (int stage = 0; stage < CHUNK_STAGE_COUNT; ++stage) {
+                length += snprintf(buf + length, 256 - length, " %s %zu", chunk_stage_names[stage], stages[stage]);
+            }
+            ImGui::Button(buf);
+            snprintf(buf, 256, "Loading: %zu chunks in view\n", GLOBAL_state.world.loading_in_view);
+            ImGui::Button(buf);
+            snprintf(buf, 256, "Culling: %zu/%zu chunks visible\n", GLOBAL_state.visible_chunks.count, GLOBAL_state.visible_chunks.tested);
+            ImGui::Button(buf);
+            snprintf(buf, 256, "Simulation: %.0f Hz, %d ticks this frame\n", GLOBAL_state.simulation.tick_rate, GLOBAL_state.simulation.frame_ticks);
+            ImGui::Button(buf);
+            snprintf(buf, 256, "Last edit: %.1f us, %d chunks rebuilt\n", GLOBAL_state.edit_us, GLOBAL_state.edit_chunks);
+            ImGui::Button(buf);
+            snprintf(buf, 256, "Draw calls: %zu (%zu vertices)\n", GLOBAL_state.render.stats.draw_calls, GLOBAL_state.render.stats.vertices);
+            ImGui::Button(buf);
             ImGui::PopStyleColor();
         ImGui::End();
 
         ImGui::Begin("Debug Stuff");
             ImGui::ColorEdit3("Background color", GLOBAL_state.bg_color);
-            ImGui::DragFloat2("Rotation", GLOBAL_state.render.camera.yaw_pitch.Elements);
+            ImGui::DragFloat2("Rotation", GLOBAL_state.simulation.camera.yaw_pitch.Elements);
+            // Recordings keep the rate they started with
+            ImGui::DragFloat("Simulation rate (Hz)", &GLOBAL_state.simulation.tick_rate, 1.0f, 10.0f, 240.0f);
             ImGui::Checkbox("Wireframe", &GLOBAL_state.render.properties.wireframe_mode);
             ImGui::Checkbox("Disable VSync", &GLOBAL_state.render.properties.disable_vsync);
+            ImGui::DragFloat("Streaming budget (ms)", &GLOBAL_state.streaming_budget_ms, 0.1f, 0.0f, 16.0f);
+            if (ImGui::Combo("Chunk drawing", (int*)&GLOBAL_state.chunk_draw_mode, chunk_draw_mode_names, CHUNK_DRAW_MODE_COUNT)) {
+                // Chunks are built either as meshes or as instances
+                mark_world_meshes_dirty(&GLOBAL_state.world);
+            }
+            if (ImGui::Combo("Chunk meshing", (int*)&GLOBAL_state.chunk_mesh_mode, chunk_mesh_mode_names, CHUNK_MESH_MODE_COUNT)) {
+                mark_world_meshes_dirty(&GLOBAL_state.world);
+            }
 
             static bool show_demo_window = false;
             ImGui::Checkbox("Show demo window", &show_demo_window);
@@ -746,22 +509,96 @@ static void ui(void)
             if (show_debug_window) {
                 ImGui::ShowMetricsWindow();
             }  
+            bool profiler_enabled = is_profiler_enabled();
+            if (ImGui::Checkbox("Record profile", &profiler_enabled)) {
+                set_profiler_enabled(profiler_enabled);
+            }
+            ImGui::SameLine();
+            if (ImGui::Button("Save trace")) {
+                if (write_profiler_trace(PROFILER_TRACE_PATH)) {
+                    printf("Profiler: wrote %s\n", PROFILER_TRACE_PATH);
+                }
+            }
+            if (GLOBAL_state.input_recorder.file) {
+                if (ImGui::Button("Stop recording")) {
+                    stop_input_recording(&GLOBAL_state);
+                }
+                ImGui::SameLine();
+                ImGui::Text("%llu frames", (unsigned long long)GLOBAL_state.input_recorder.frame_count);
+            } else if (GLOBAL_state.input_replay.data) {
+                if (ImGui::Button("Stop replay")) {
+                    stop_input_replay(&GLOBAL_state);
+                }
+                ImGui::SameLine();
+                ImGui::Text("Frame %llu", (unsigned long long)GLOBAL_state.input_replay.frame_count);
+            } else {
+                if (ImGui::Button("Record input")) {
+                    start_input_recording(&GLOBAL_state, INPUT_RECORD_PATH);
+                }
+                ImGui::SameLine();
+                if (ImGui::Button("Replay input")) {
+                    start_input_replay(&GLOBAL_state, INPUT_RECORD_PATH);
+                }
+                ImGui::Checkbox("Drain chunk jobs while replaying", &GLOBAL_state.replay_drain_jobs);
+            }
+            static bool show_frame_history = false;
+            if (ImGui::Checkbox("Show frame history", &show_frame_history) && show_frame_history) {
+                // The flame graph needs the zones
+                set_profiler_enabled(true);
+            }
         ImGui::End();
+
+        if (show_frame_history) {
+            frame_history_window(&GLOBAL_state.frame_history, &show_frame_history);
+        }
     }
     simgui_render();
 }
 
 void frame(void)
 {
+    begin_frame_history(&GLOBAL_state.frame_history);
+    PROFILE_ZONE("frame");
+    begin_input_frame(&GLOBAL_state);
     handle_camera(&GLOBAL_state);
+    record_input(&GLOBAL_state);
     set_bgcolor(&GLOBAL_state.render, GLOBAL_state.bg_color);
     sapp_set_window_title("Cave Tropes 0.0.1");
+    // Drained frames take everything the previous one finished, whatever the time
+    bool drain_jobs = GLOBAL_state.input_replay.data && GLOBAL_state.replay_drain_jobs;
+    double streaming_budget = drain_jobs ? INFINITY : GLOBAL_state.streaming_budget_ms / 1000.0;
+    ::job_counter chunk_jobs = {};
+    ::job_counter *frame_jobs = drain_jobs ? &chunk_jobs : nullptr;
+    integrate_world_chunks(&GLOBAL_state.world, streaming_budget);
+    // The drawn camera for both, so the chunks loaded first are the ones around what is on screen
     change_world_chunk_offset_relative_to_camera(&GLOBAL_state.world, &GLOBAL_state.render.camera);
-    generate_world(&GLOBAL_state.world);
+    generate_world(&GLOBAL_state.world, &GLOBAL_state.jobs, &GLOBAL_state.render.camera, frame_jobs);
+    bool instanced = GLOBAL_state.chunk_draw_mode == CHUNK_DRAW_MODE_INSTANCED;
+    update_world_meshes(&GLOBAL_state.world, &GLOBAL_state.chunk_mesh_uploads, &GLOBAL_state.jobs, GLOBAL_state.chunk_mesh_mode, instanced, frame_jobs);
+    if (frame_jobs) {
+        wait_for_counter(&GLOBAL_state.jobs, frame_jobs);
+    }
+    edit_world_block(&GLOBAL_state);
+    upload_world_meshes(&GLOBAL_state.render, &GLOBAL_state.chunk_mesh_uploads, streaming_budget);
 
-    begin_render(&GLOBAL_state.render);
+    get_visible_world_chunks(&GLOBAL_state.world, &GLOBAL_state.render.camera.get_frustum(), &GLOBAL_state.visible_chunks);
+
+    if (flush_render_pipeline(&GLOBAL_state.render)) {
+        apply_vsync(GLOBAL_state.render.properties);
+    }
+    begin_render(&GLOBAL_state.render, sapp_width(), sapp_height());
     {
-        draw_world(&GLOBAL_state.render, &GLOBAL_state.cube_mesh_cache, GLOBAL_state.world);
+        switch (GLOBAL_state.chunk_draw_mode) {
+            case CHUNK_DRAW_MODE_INSTANCED:
+                draw_world_instanced(&GLOBAL_state.render, GLOBAL_state.visible_chunks);
+                break;
+            case CHUNK_DRAW_MODE_PER_VOXEL:
+                draw_world_per_voxel(&GLOBAL_state.render, &GLOBAL_state.cube_mesh_cache, GLOBAL_state.visible_chunks);
+                break;
+            default:
+                draw_world(&GLOBAL_state.render, GLOBAL_state.visible_chunks);
+                break;
+        }
         ui();
     }
     end_render(&GLOBAL_state.render);
@@ -774,18 +611,39 @@ static void event(const sapp_event *event)
     if (simgui_handle_event(event)) {
         return;
     }
+    // The replay decides the input
+    if (GLOBAL_state.input_replay.data) {
+        return;
+    }
     GLOBAL_state.input.pass_event(event);
 }
 
 void cleanup(void)
 {
+    stop_input_recording(&GLOBAL_state);
+    unload_input_replay(&GLOBAL_state.input_replay);
+    deinit_job_system(&GLOBAL_state.jobs);
+    deinit_chunk_mesh_uploads(&GLOBAL_state.chunk_mesh_uploads);
+    deinit_world_meshes(&GLOBAL_state.world);
+    deinit_world(&GLOBAL_state.world);
     simgui_shutdown();
     sg_shutdown();
+    deinit_frame_history(&GLOBAL_state.frame_history);
+    deinit_profiler();
 }
 
 sapp_desc sokol_main(int argc, char* argv[])
 {
-    (void)argc; (void)argv;
+    // cave_tropes [--record path | --replay path]
+    for (int i = 1; i+1 < argc; i += 2) {
+        if (strcmp(argv[i], "--record") == 0) {
+            GLOBAL_record_path = argv[i+1];
+        } else if (strcmp(argv[i], "--replay") == 0) {
+            GLOBAL_replay_path = argv[i+1];
+        } else {
+            fprintf(stderr, "Unknown option %s\n", argv[i]);
+        }
+    }
     sapp_desc app_desc = {};
     app_desc.init_cb = init;
     app_desc.frame_cb = frame;
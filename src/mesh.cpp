@@ -0,0 +1,107 @@
+#include "mesh.h"
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
+
+float cube_vertices[6*4*8] = {
+    // pos                normal    uv
+    // +y
+    -0.5, 0.5, -0.5,      0, 1, 0,  0, 1,
+    -0.5, 0.5, 0.5,       0, 1, 0,  1, 1,
+    0.5, 0.5, 0.5,        0, 1, 0,  1, 0,
+    0.5, 0.5, -0.5,       0, 1, 0,  0, 0,
+
+    // -x    
+    -0.5, 0.5, 0.5,       -1, 0, 0, 0, 0,
+    -0.5, -0.5, 0.5,      -1, 0, 0, 0, 1,
+    -0.5, -0.5, -0.5,     -1, 0, 0, 1, 1,
+    -0.5, 0.5, -0.5,      -1, 0, 0, 1, 0,
+
+    // +x
+    0.5, 0.5, 0.5,        1, 0, 0, 0, 0,
+    0.5, -0.5, 0.5,       1, 0, 0, 0, 1,
+    0.5, -0.5, -0.5,      1, 0, 0, 1, 1,
+    0.5, 0.5, -0.5,       1, 0, 0, 1, 0,
+
+    // -z
+    0.5, 0.5, 0.5,        0, 0, -1, 0, 0,
+    0.5, -0.5, 0.5,       0, 0, -1, 0, 1,
+    -0.5, -0.5, 0.5,      0, 0, -1, 1, 1,
+    -0.5, 0.5, 0.5,       0, 0, -1, 1, 0,
+
+    // +z
+    0.5, 0.5, -0.5,       0, 0, 1, 0, 0,
+    0.5, -0.5, -0.5,      0, 0, 1, 0, 1,
+    -0.5, -0.5, -0.5,     0, 0, 1, 1, 1,
+    -0.5, 0.5, -0.5,      0, 0, 1, 1, 0,
+
+    // -y    
+    -0.5, -0.5, -0.5,     0, -1, 0, 0, 1,
+    -0.5, -0.5, 0.5,      0, -1, 0, 1, 1,
+    0.5, -0.5, 0.5,       0, -1, 0, 1, 0,
+    0.5, -0.5, -0.5,      0, -1, 0, 0, 0
+};
+
+uint16_t cube_indices[6*6] = {
+    0, 1, 2,  0, 2, 3,       // +y
+    6, 5, 4,  7, 6, 4,       // -x
+    8, 9, 10,  8, 10, 11,    // +x
+    14, 13, 12,  15, 14, 12, // -z
+    16, 17, 18,  16, 18, 19, // +z
+    22, 21, 20,  23, 22, 20  // -y
+};
+
+const cube_side_flags cube_quad_side_flags[6] = {
+    CUBE_SIDE_FLAG_PY,
+    CUBE_SIDE_FLAG_NX,
+    CUBE_SIDE_FLAG_PX,
+    CUBE_SIDE_FLAG_PZ,
+    CUBE_SIDE_FLAG_NZ,
+    CUBE_SIDE_FLAG_NY
+};
+
+size_t get_cube_side_quad_no(cube_side_flags side)
+{
+    for (size_t quad_no = 0; quad_no < 6; ++quad_no) {
+        if (cube_quad_side_flags[quad_no] == side) {
+            return quad_no;
+        }
+    }
+    return 0;
+}
+
+::combined_buffer init_combined_buffer_malloc(size_t stride, size_t vertex_count, size_t index_count)
+{
+    return (::combined_buffer){stride, 0, 0, (float*)malloc((vertex_count * stride) * sizeof(float)), (uint16_t*)malloc(index_count * sizeof(uint16_t))};
+}
+
+void deinit_combined_buffer_malloc(::combined_buffer *buffer)
+{
+    free(buffer->vertices);
+    free(buffer->indices);
+}
+
+void append_cube_quad_to_combined_buffer(::combined_buffer *buffer, size_t quad_no)
+{
+    // assert that the vertex buffer is trivially copyable
+    assert(buffer->stride == 8);
+    assert(buffer->index_count % 6 == 0);
+
+    const size_t
+        output_vertex_offset = buffer->vertex_count * buffer->stride,
+        output_index_offset = buffer->index_count,
+        output_quad_no = buffer->index_count / 6,
+        input_vertex_offset = quad_no * 4 * buffer->stride,
+        input_index_offset = quad_no * 6;
+
+    memcpy(buffer->vertices + output_vertex_offset, cube_vertices + input_vertex_offset, buffer->stride * sizeof(float) * 4);
+    memcpy(buffer->indices + output_index_offset, cube_indices + input_index_offset, sizeof(uint16_t) * 6);
+
+    for (size_t i = output_index_offset; i < output_index_offset+6; ++i) {
+        buffer->indices[i] -= quad_no * 4; // transform to relative
+        buffer->indices[i] += output_quad_no * 4; // transform to absolute in output buffer
+    }
+
+    buffer->index_count += 6;
+    buffer->vertex_count += 4;
+}
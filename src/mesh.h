@@ -0,0 +1,65 @@
+#ifndef CT_MESH_H
+#define CT_MESH_H
+
+#include <cstddef>
+#include <cstdint>
+#include "lib/sokol/sokol_gfx.h"
+#include "lib/HandmadeMath.h"
+
+// Flags for choosing sides of cube to display
+typedef uint8_t cube_side_flags;
+#define CUBE_SIDE_FLAG_PX 0b1
+#define CUBE_SIDE_FLAG_NX 0b10
+#define CUBE_SIDE_FLAG_PY 0b100
+#define CUBE_SIDE_FLAG_NY 0b1000
+#define CUBE_SIDE_FLAG_PZ 0b10000
+#define CUBE_SIDE_FLAG_NZ 0b100000
+
+// Bit index of each side in cube_side_flags
+enum cube_side {
+    CUBE_SIDE_PX,
+    CUBE_SIDE_NX,
+    CUBE_SIDE_PY,
+    CUBE_SIDE_NY,
+    CUBE_SIDE_PZ,
+    CUBE_SIDE_NZ,
+    CUBE_SIDE_COUNT
+};
+
+// 6 quads, 4 vertices each, 8 floats per vertex (pos, normal, uv)
+extern float cube_vertices[6*4*8];
+extern uint16_t cube_indices[6*6];
+// Side flag of each quad in cube_vertices, in quad order
+extern const cube_side_flags cube_quad_side_flags[6];
+
+// Finds the quad in cube_vertices that shows the given side
+size_t get_cube_side_quad_no(cube_side_flags side);
+
+struct combined_buffer_gpu {
+    sg_buffer vertices;
+    sg_buffer indices;
+    size_t index_count;
+};
+
+struct combined_buffer {
+    size_t stride;
+    size_t vertex_count;
+    size_t index_count;
+    float *vertices;
+    uint16_t *indices;
+};
+
+::combined_buffer init_combined_buffer_malloc(size_t stride, size_t vertex_count, size_t index_count);
+
+// deinits combined buffer that was allocated with malloc
+void deinit_combined_buffer_malloc(::combined_buffer *buffer);
+
+/**
+ * @brief      Appends a cube quad to combined buffer.
+ *
+ * @param      buffer   The combined buffer
+ * @param[in]  quad_no  The quad number (check the vertex buffer constant in mesh.cpp)
+ */
+void append_cube_quad_to_combined_buffer(::combined_buffer *buffer, size_t quad_no);
+
+#endif
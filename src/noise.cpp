@@ -0,0 +1,429 @@
+#include "noise.h"
+#include "profiler.h"
+#include <cassert>
+#include <cmath>
+#include <cstring>
+
+#ifdef CPU_ISA_X86
+#include <immintrin.h>
+#endif
+
+// The kernels do the same float operations in the same order, and none of them
+// can be fused (FMA is not enabled), which is what keeps them bit-identical.
+
+const char *noise_type_names[NOISE_TYPE_COUNT] = {"Perlin", "fBm", "Ridged", "Worley"};
+
+// The parameters worked out per octave, so every kernel scales and sums the same numbers
+struct noise_octaves {
+    ::noise_type type;
+    int count;
+    float frequencies[NOISE_MAX_OCTAVES];
+    float amplitudes[NOISE_MAX_OCTAVES];
+    uint32_t seeds[NOISE_MAX_OCTAVES];
+    int lattice_steps[NOISE_MAX_OCTAVES];
+    // Brings the sum of the octaves back to the range of one octave
+    float scale;
+};
+
+static ::noise_octaves get_noise_octaves(::noise_params const *params)
+{
+    ::noise_octaves output = {};
+    output.type = params->type;
+    bool layered = params->type == NOISE_TYPE_FBM || params->type == NOISE_TYPE_RIDGED;
+    output.count = layered ? HMM_MAX(1, HMM_MIN(params->octaves, NOISE_MAX_OCTAVES)) : 1;
+
+    float frequency = params->frequency, amplitude = 1, total = 0;
+    for (int i = 0; i < output.count; ++i) {
+        output.frequencies[i] = frequency;
+        output.amplitudes[i] = amplitude;
+        output.seeds[i] = params->seed + i*0x9E3779B9u;
+        output.lattice_steps[i] = HMM_MAX(1, params->lattice_steps[i]);
+        assert((output.lattice_steps[i] & (output.lattice_steps[i] - 1)) == 0 && output.lattice_steps[i] <= CHUNK_SIZE && "Lattice steps are powers of two up to CHUNK_SIZE");
+        total += amplitude;
+        frequency *= params->lacunarity;
+        amplitude *= params->gain;
+    }
+    output.scale = 1 / total;
+    return output;
+}
+
+static uint32_t hash_noise_cell(uint32_t seed, uint32_t x, uint32_t y, uint32_t z)
+{
+    uint32_t h = seed ^ x*0x8DA6B343u ^ y*0xD8163841u ^ z*0xCB1AB31Fu;
+    h *= 0x27D4EB2Du;
+    return h ^ (h >> 15);
+}
+
+// One of the 12 edge gradients of a cube (4 of them twice) dotted with the offset
+static float get_noise_gradient(uint32_t hash, float x, float y, float z)
+{
+    uint32_t h = hash & 15;
+    float u = h < 8 ? x : y;
+    float v = h < 4 ? y : ((h | 2) == 14 ? x : z);
+    return ((h & 1) ? -u : u) + ((h & 2) ? -v : v);
+}
+
+static float fade_noise(float t)
+{
+    return t*t*t * (t*(t*6 - 15) + 10);
+}
+
+static float lerp_noise(float a, float b, float t)
+{
+    return a + t*(b - a);
+}
+
+static float perlin_noise_scalar(uint32_t seed, float x, float y, float z)
+{
+    float x0 = floorf(x), y0 = floorf(y), z0 = floorf(z);
+    uint32_t ix = (int32_t)x0, iy = (int32_t)y0, iz = (int32_t)z0;
+    float fx = x - x0, fy = y - y0, fz = z - z0;
+    float u = fade_noise(fx), v = fade_noise(fy), w = fade_noise(fz);
+
+    float corners[2][2][2];
+    for (uint32_t k = 0; k < 2; ++k) {
+        for (uint32_t j = 0; j < 2; ++j) {
+            for (uint32_t i = 0; i < 2; ++i) {
+                corners[k][j][i] = get_noise_gradient(hash_noise_cell(seed, ix+i, iy+j, iz+k), fx - i, fy - j, fz - k);
+            }
+        }
+    }
+
+    float y00 = lerp_noise(corners[0][0][0], corners[0][0][1], u);
+    float y01 = lerp_noise(corners[0][1][0], corners[0][1][1], u);
+    float y10 = lerp_noise(corners[1][0][0], corners[1][0][1], u);
+    float y11 = lerp_noise(corners[1][1][0], corners[1][1][1], u);
+    return lerp_noise(lerp_noise(y00, y01, v), lerp_noise(y10, y11, v), w);
+}
+
+static float worley_noise_scalar(uint32_t seed, float x, float y, float z)
+{
+    float x0 = floorf(x), y0 = floorf(y), z0 = floorf(z);
+    uint32_t ix = (int32_t)x0, iy = (int32_t)y0, iz = (int32_t)z0;
+    float fx = x - x0, fy = y - y0, fz = z - z0;
+
+    // The nearest point is always in one of the 27 cells around
+    float nearest = 8;
+    for (int k = -1; k <= 1; ++k) {
+        for (int j = -1; j <= 1; ++j) {
+            for (int i = -1; i <= 1; ++i) {
+                uint32_t h = hash_noise_cell(seed, ix+i, iy+j, iz+k);
+                float dx = ((float)i + (float)(h & 1023)*(1.0f/1024)) - fx;
+                float dy = ((float)j + (float)((h >> 10) & 1023)*(1.0f/1024)) - fy;
+                float dz = ((float)k + (float)((h >> 20) & 1023)*(1.0f/1024)) - fz;
+                float distance = dx*dx + dy*dy + dz*dz;
+                nearest = distance < nearest ? distance : nearest;
+            }
+        }
+    }
+    return sqrtf(nearest);
+}
+
+static void noise_kernel_scalar(::noise_octaves const *octaves, float const *x, float const *y, float const *z, float *output, size_t count)
+{
+    for (size_t n = 0; n < count; ++n) {
+        float sum = 0;
+        for (int i = 0; i < octaves->count; ++i) {
+            float f = octaves->frequencies[i];
+            float px = x[n]*f, py = y[n]*f, pz = z[n]*f;
+            float value;
+            if (octaves->type == NOISE_TYPE_WORLEY) {
+                value = worley_noise_scalar(octaves->seeds[i], px, py, pz);
+            } else {
+                value = perlin_noise_scalar(octaves->seeds[i], px, py, pz);
+            }
+            if (octaves->type == NOISE_TYPE_RIDGED) {
+                value = 1 - fabsf(value);
+                value = value*value;
+            }
+            sum = sum + octaves->amplitudes[i]*value;
+        }
+        output[n] = sum*octaves->scale;
+    }
+}
+
+#ifdef CPU_ISA_X86
+#define AVX2 __attribute__((target("avx2")))
+
+AVX2 static inline __m256i hash_noise_cell_avx2(__m256i seed, __m256i x, __m256i y, __m256i z)
+{
+    __m256i h = _mm256_xor_si256(seed, _mm256_mullo_epi32(x, _mm256_set1_epi32(0x8DA6B343u)));
+    h = _mm256_xor_si256(h, _mm256_mullo_epi32(y, _mm256_set1_epi32(0xD8163841u)));
+    h = _mm256_xor_si256(h, _mm256_mullo_epi32(z, _mm256_set1_epi32(0xCB1AB31Fu)));
+    h = _mm256_mullo_epi32(h, _mm256_set1_epi32(0x27D4EB2Du));
+    return _mm256_xor_si256(h, _mm256_srli_epi32(h, 15));
+}
+
+AVX2 static inline __m256 get_noise_gradient_avx2(__m256i hash, __m256 x, __m256 y, __m256 z)
+{
+    __m256i h = _mm256_and_si256(hash, _mm256_set1_epi32(15));
+    __m256 below_8 = _mm256_castsi256_ps(_mm256_cmpgt_epi32(_mm256_set1_epi32(8), h));
+    __m256 below_4 = _mm256_castsi256_ps(_mm256_cmpgt_epi32(_mm256_set1_epi32(4), h));
+    __m256 is_x = _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_or_si256(h, _mm256_set1_epi32(2)), _mm256_set1_epi32(14)));
+
+    // blendv(a, b, mask) takes b where the mask is set
+    __m256 u = _mm256_blendv_ps(y, x, below_8);
+    __m256 v = _mm256_blendv_ps(_mm256_blendv_ps(z, x, is_x), y, below_4);
+    // Negating flips the sign bit, same as the scalar minus
+    __m256 u_sign = _mm256_castsi256_ps(_mm256_slli_epi32(h, 31));
+    __m256 v_sign = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_srli_epi32(h, 1), 31));
+    return _mm256_add_ps(_mm256_xor_ps(u, u_sign), _mm256_xor_ps(v, v_sign));
+}
+
+AVX2 static inline __m256 fade_noise_avx2(__m256 t)
+{
+    __m256 t3 = _mm256_mul_ps(_mm256_mul_ps(t, t), t);
+    __m256 inner = _mm256_sub_ps(_mm256_mul_ps(t, _mm256_set1_ps(6)), _mm256_set1_ps(15));
+    return _mm256_mul_ps(t3, _mm256_add_ps(_mm256_mul_ps(t, inner), _mm256_set1_ps(10)));
+}
+
+AVX2 static inline __m256 lerp_noise_avx2(__m256 a, __m256 b, __m256 t)
+{
+    return _mm256_add_ps(a, _mm256_mul_ps(t, _mm256_sub_ps(b, a)));
+}
+
+AVX2 static __m256 perlin_noise_avx2(__m256i seed, __m256 x, __m256 y, __m256 z)
+{
+    __m256 x0 = _mm256_floor_ps(x), y0 = _mm256_floor_ps(y), z0 = _mm256_floor_ps(z);
+    __m256i ix = _mm256_cvttps_epi32(x0), iy = _mm256_cvttps_epi32(y0), iz = _mm256_cvttps_epi32(z0);
+    __m256 fx = _mm256_sub_ps(x, x0), fy = _mm256_sub_ps(y, y0), fz = _mm256_sub_ps(z, z0);
+    __m256 u = fade_noise_avx2(fx), v = fade_noise_avx2(fy), w = fade_noise_avx2(fz);
+
+    __m256 corners[2][2][2];
+    for (int k = 0; k < 2; ++k) {
+        for (int j = 0; j < 2; ++j) {
+            for (int i = 0; i < 2; ++i) {
+                __m256i h = hash_noise_cell_avx2(seed, _mm256_add_epi32(ix, _mm256_set1_epi32(i)), _mm256_add_epi32(iy, _mm256_set1_epi32(j)), _mm256_add_epi32(iz, _mm256_set1_epi32(k)));
+                corners[k][j][i] = get_noise_gradient_avx2(h, _mm256_sub_ps(fx, _mm256_set1_ps(i)), _mm256_sub_ps(fy, _mm256_set1_ps(j)), _mm256_sub_ps(fz, _mm256_set1_ps(k)));
+            }
+        }
+    }
+
+    __m256 y00 = lerp_noise_avx2(corners[0][0][0], corners[0][0][1], u);
+    __m256 y01 = lerp_noise_avx2(corners[0][1][0], corners[0][1][1], u);
+    __m256 y10 = lerp_noise_avx2(corners[1][0][0], corners[1][0][1], u);
+    __m256 y11 = lerp_noise_avx2(corners[1][1][0], corners[1][1][1], u);
+    return lerp_noise_avx2(lerp_noise_avx2(y00, y01, v), lerp_noise_avx2(y10, y11, v), w);
+}
+
+AVX2 static __m256 worley_noise_avx2(__m256i seed, __m256 x, __m256 y, __m256 z)
+{
+    __m256 x0 = _mm256_floor_ps(x), y0 = _mm256_floor_ps(y), z0 = _mm256_floor_ps(z);
+    __m256i ix = _mm256_cvttps_epi32(x0), iy = _mm256_cvttps_epi32(y0), iz = _mm256_cvttps_epi32(z0);
+    __m256 fx = _mm256_sub_ps(x, x0), fy = _mm256_sub_ps(y, y0), fz = _mm256_sub_ps(z, z0);
+    const __m256i bits = _mm256_set1_epi32(1023);
+    const __m256 unit = _mm256_set1_ps(1.0f/1024);
+
+    __m256 nearest = _mm256_set1_ps(8);
+    for (int k = -1; k <= 1; ++k) {
+        for (int j = -1; j <= 1; ++j) {
+            for (int i = -1; i <= 1; ++i) {
+                __m256i h = hash_noise_cell_avx2(seed, _mm256_add_epi32(ix, _mm256_set1_epi32(i)), _mm256_add_epi32(iy, _mm256_set1_epi32(j)), _mm256_add_epi32(iz, _mm256_set1_epi32(k)));
+                __m256 ox = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_and_si256(h, bits)), unit);
+                __m256 oy = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(h, 10), bits)), unit);
+                __m256 oz = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(h, 20), bits)), unit);
+                __m256 dx = _mm256_sub_ps(_mm256_add_ps(_mm256_set1_ps(i), ox), fx);
+                __m256 dy = _mm256_sub_ps(_mm256_add_ps(_mm256_set1_ps(j), oy), fy);
+                __m256 dz = _mm256_sub_ps(_mm256_add_ps(_mm256_set1_ps(k), oz), fz);
+                __m256 distance = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)), _mm256_mul_ps(dz, dz));
+                nearest = _mm256_min_ps(distance, nearest);
+            }
+        }
+    }
+    return _mm256_sqrt_ps(nearest);
+}
+
+AVX2 static void noise_kernel_avx2(::noise_octaves const *octaves, float const *x, float const *y, float const *z, float *output, size_t count)
+{
+    const __m256 sign = _mm256_set1_ps(-0.0f);
+    size_t n = 0;
+    for (; n + 8 <= count; n += 8) {
+        __m256 px = _mm256_loadu_ps(x + n), py = _mm256_loadu_ps(y + n), pz = _mm256_loadu_ps(z + n);
+        __m256 sum = _mm256_setzero_ps();
+        for (int i = 0; i < octaves->count; ++i) {
+            __m256 f = _mm256_set1_ps(octaves->frequencies[i]);
+            __m256i seed = _mm256_set1_epi32(octaves->seeds[i]);
+            __m256 value;
+            if (octaves->type == NOISE_TYPE_WORLEY) {
+                value = worley_noise_avx2(seed, _mm256_mul_ps(px, f), _mm256_mul_ps(py, f), _mm256_mul_ps(pz, f));
+            } else {
+                value = perlin_noise_avx2(seed, _mm256_mul_ps(px, f), _mm256_mul_ps(py, f), _mm256_mul_ps(pz, f));
+            }
+            if (octaves->type == NOISE_TYPE_RIDGED) {
+                // andnot(a, b) is ~a & b, clears the sign bit
+                value = _mm256_sub_ps(_mm256_set1_ps(1), _mm256_andnot_ps(sign, value));
+                value = _mm256_mul_ps(value, value);
+            }
+            sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_set1_ps(octaves->amplitudes[i]), value));
+        }
+        _mm256_storeu_ps(output + n, _mm256_mul_ps(sum, _mm256_set1_ps(octaves->scale)));
+    }
+
+    // The scalar kernel gives the same values for the rest
+    noise_kernel_scalar(octaves, x + n, y + n, z + n, output + n, count - n);
+}
+#endif
+
+typedef void (*noise_kernel_fn)(::noise_octaves const *octaves, float const *x, float const *y, float const *z, float *output, size_t count);
+
+#ifdef CPU_ISA_X86
+::cpu_isa_kernels noise_kernels = {CPU_ISA_BIT(CPU_ISA_SCALAR) | CPU_ISA_BIT(CPU_ISA_AVX2), {CPU_ISA_COUNT}};
+#else
+::cpu_isa_kernels noise_kernels = {CPU_ISA_BIT(CPU_ISA_SCALAR), {CPU_ISA_COUNT}};
+#endif
+
+static noise_kernel_fn get_noise_kernel(::cpu_isa isa)
+{
+    switch (isa) {
+#ifdef CPU_ISA_X86
+        case CPU_ISA_AVX2:
+            return noise_kernel_avx2;
+#endif
+        default:
+            return noise_kernel_scalar;
+    }
+}
+
+void sample_noise(::noise_params const *params, float const *x, float const *y, float const *z, float *output, size_t count)
+{
+    ::noise_octaves octaves = get_noise_octaves(params);
+    get_noise_kernel(get_cpu_isa(&noise_kernels))(&octaves, x, y, z, output, count);
+}
+
+// The octaves sampled at a lattice step, summed and scaled by their amplitudes
+static ::noise_octaves get_lattice_noise_octaves(::noise_octaves const *octaves, int step)
+{
+    ::noise_octaves output = {};
+    output.type = octaves->type;
+    output.scale = 1;
+    for (int i = 0; i < octaves->count; ++i) {
+        if (octaves->lattice_steps[i] == step) {
+            output.frequencies[output.count] = octaves->frequencies[i];
+            output.amplitudes[output.count] = octaves->amplitudes[i];
+            output.seeds[output.count] = octaves->seeds[i];
+            output.lattice_steps[output.count] = step;
+            output.count++;
+        }
+    }
+    return output;
+}
+
+// Adds octaves evaluated at every block
+static void add_chunk_noise_octaves(noise_kernel_fn kernel, ::noise_octaves const *octaves, vec3i origin, chunk_density &output)
+{
+    float xs[CHUNK_SIZE], ys[CHUNK_SIZE], zs[CHUNK_SIZE], values[CHUNK_SIZE];
+    for (int y = 0; y < CHUNK_SIZE; ++y) {
+        ys[y] = origin.y + y;
+    }
+    for (int x = 0; x < CHUNK_SIZE; ++x) {
+        for (int z = 0; z < CHUNK_SIZE; ++z) {
+            for (int y = 0; y < CHUNK_SIZE; ++y) {
+                xs[y] = origin.x + x;
+                zs[y] = origin.z + z;
+            }
+            kernel(octaves, xs, ys, zs, values, CHUNK_SIZE);
+            for (int y = 0; y < CHUNK_SIZE; ++y) {
+                output[x][z][y] += values[y];
+            }
+        }
+    }
+}
+
+#define NOISE_MAX_LATTICE_SIZE (CHUNK_SIZE/2 + 1)
+
+// Adds octaves of the same step evaluated on a lattice, including the points on the far border of the chunk,
+// and upsampled trilinearly. The upsampling is plain loops over y, vectorized by the compiler, so it is the same on every ISA.
+static void add_chunk_noise_octaves_coarse(noise_kernel_fn kernel, ::noise_octaves const *octaves, vec3i origin, chunk_density &output)
+{
+    const int step = octaves->lattice_steps[0], size = CHUNK_SIZE/step + 1;
+    const float inverse_step = 1.0f / step;
+
+    //            x                        z                    y
+    float columns[NOISE_MAX_LATTICE_SIZE][NOISE_MAX_LATTICE_SIZE][CHUNK_SIZE];
+    // One x slab of the lattice per kernel call, a lattice column alone is too short for the wide kernels
+    const int slab_size = NOISE_MAX_LATTICE_SIZE*NOISE_MAX_LATTICE_SIZE;
+    float xs[slab_size], ys[slab_size], zs[slab_size], values[slab_size];
+    for (int i = 0; i < size; ++i) {
+        for (int k = 0; k < size; ++k) {
+            for (int j = 0; j < size; ++j) {
+                xs[k*size + j] = origin.x + i*step;
+                ys[k*size + j] = origin.y + j*step;
+                zs[k*size + j] = origin.z + k*step;
+            }
+        }
+        kernel(octaves, xs, ys, zs, values, size*size);
+
+        // Fill in the columns along y first, so x and z can be blended a whole column at a time
+        for (int k = 0; k < size; ++k) {
+            float const *lattice = values + k*size;
+            for (int y = 0; y < CHUNK_SIZE; ++y) {
+                float a = lattice[y/step], b = lattice[y/step + 1], t = (y % step) * inverse_step;
+                columns[i][k][y] = a + t*(b - a);
+            }
+        }
+    }
+
+    for (int x = 0; x < CHUNK_SIZE; ++x) {
+        int i = x/step;
+        float tx = (x % step) * inverse_step;
+        for (int z = 0; z < CHUNK_SIZE; ++z) {
+            int k = z/step;
+            float tz = (z % step) * inverse_step;
+            float const *c00 = columns[i][k], *c10 = columns[i+1][k], *c01 = columns[i][k+1], *c11 = columns[i+1][k+1];
+            float *out = output[x][z];
+            for (int y = 0; y < CHUNK_SIZE; ++y) {
+                float near = c00[y] + tx*(c10[y] - c00[y]);
+                float far = c01[y] + tx*(c11[y] - c01[y]);
+                out[y] += near + tz*(far - near);
+            }
+        }
+    }
+}
+
+void sample_chunk_noise(::noise_params const *params, vec3i chunk, chunk_density &output)
+{
+    PROFILE_FUNCTION();
+    ::noise_octaves octaves = get_noise_octaves(params);
+    const noise_kernel_fn kernel = get_noise_kernel(get_cpu_isa(&noise_kernels));
+    vec3i origin = chunk * CHUNK_SIZE;
+
+    bool coarse = false;
+    for (int i = 0; i < octaves.count; ++i) {
+        coarse = coarse || octaves.lattice_steps[i] > 1;
+    }
+    if (coarse) {
+        // Octaves of the same step are summed on their lattice, so each step is upsampled once
+        memset(output, 0, sizeof output);
+        for (int step = 1; step <= CHUNK_SIZE; step *= 2) {
+            ::noise_octaves lattice_octaves = get_lattice_noise_octaves(&octaves, step);
+            if (lattice_octaves.count == 0) {
+                continue;
+            }
+            if (step > 1) {
+                add_chunk_noise_octaves_coarse(kernel, &lattice_octaves, origin, output);
+            } else {
+                add_chunk_noise_octaves(kernel, &lattice_octaves, origin, output);
+            }
+        }
+        float *values = &output[0][0][0];
+        for (int i = 0; i < CHUNK_SIZE*CHUNK_SIZE*CHUNK_SIZE; ++i) {
+            values[i] *= octaves.scale;
+        }
+        return;
+    }
+
+    // One column at a time, y is the only coordinate that changes along it
+    float xs[CHUNK_SIZE], ys[CHUNK_SIZE], zs[CHUNK_SIZE];
+    for (int y = 0; y < CHUNK_SIZE; ++y) {
+        ys[y] = origin.y + y;
+    }
+    for (int x = 0; x < CHUNK_SIZE; ++x) {
+        for (int z = 0; z < CHUNK_SIZE; ++z) {
+            for (int y = 0; y < CHUNK_SIZE; ++y) {
+                xs[y] = origin.x + x;
+                zs[y] = origin.z + z;
+            }
+            kernel(&octaves, xs, ys, zs, output[x][z], CHUNK_SIZE);
+        }
+    }
+}
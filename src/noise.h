@@ -0,0 +1,61 @@
+#ifndef CT_NOISE_H
+#define CT_NOISE_H
+
+#include "cpu_isa.h"
+#include "world.h"
+
+// Kernels of the noise samplers: scalar and AVX2, every one of them gives bit-identical results
+extern ::cpu_isa_kernels noise_kernels;
+
+enum noise_type {
+    // Gradient noise, about -1 to 1
+    NOISE_TYPE_PERLIN,
+    // Octaves of gradient noise, each at lacunarity times the frequency and gain times the amplitude, about -1 to 1
+    NOISE_TYPE_FBM,
+    // Octaves of (1 - |gradient noise|)^2, sharp ridges at 1 where the noise crosses zero, 0 to 1
+    NOISE_TYPE_RIDGED,
+    // Distance to the nearest of one random point per cell, in cells, 0 to about 1
+    NOISE_TYPE_WORLEY,
+    NOISE_TYPE_COUNT
+};
+
+extern const char *noise_type_names[NOISE_TYPE_COUNT];
+
+#define NOISE_MAX_OCTAVES 8
+
+struct noise_params {
+    ::noise_type type;
+    uint32_t seed;
+    // Cells per block of the first octave
+    float frequency;
+    // Only used by fBm and ridged noise
+    int octaves;
+    float lacunarity;
+    float gain;
+    // Blocks between the lattice points sample_chunk_noise evaluates each octave at, the blocks in between
+    // are interpolated trilinearly. Powers of two up to CHUNK_SIZE, 0 is the same as 1 (every block).
+    int lattice_steps[NOISE_MAX_OCTAVES];
+};
+
+/**
+ * @brief      Evaluates noise at a list of points, 8 at a time on AVX2.
+ *             The result only depends on the parameters and the points. Lattice steps are not used here.
+ *
+ * @param[in]  params  The noise parameters
+ * @param[in]  x       The x coordinates of the points, in blocks
+ * @param[in]  y       The y coordinates
+ * @param[in]  z       The z coordinates
+ * @param      output  One value per point
+ * @param[in]  count   The number of points
+ */
+void sample_noise(::noise_params const *params, float const *x, float const *y, float const *z, float *output, size_t count);
+
+// Noise at every block of a chunk, a run of y per column like chunk::data
+//                                  x           z           y
+typedef float chunk_density[CHUNK_SIZE][CHUNK_SIZE][CHUNK_SIZE];
+
+// Evaluates noise at every block of the chunk at a position in chunk coordinates.
+// Octaves with a lattice step are sampled at a fraction of the blocks, chunk borders still line up.
+void sample_chunk_noise(::noise_params const *params, vec3i chunk, chunk_density &output);
+
+#endif
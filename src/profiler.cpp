@@ -0,0 +1,205 @@
+#include "profiler.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define PROFILER_X86
+#include <x86intrin.h>
+#endif
+
+std::atomic<bool> GLOBAL_profiler_enabled;
+
+// Every thread that recorded something, newest first
+static std::atomic<::profiler_thread*> GLOBAL_profiler_threads;
+static std::atomic<uint32_t> GLOBAL_profiler_thread_count;
+
+// Clock readings from when recording first started, to convert ticks to time
+static uint64_t GLOBAL_profiler_base_ticks;
+static std::chrono::steady_clock::time_point GLOBAL_profiler_base_time;
+
+static thread_local ::profiler_thread *GLOBAL_current_profiler_thread;
+static thread_local char GLOBAL_current_profiler_thread_name[PROFILER_THREAD_NAME_SIZE];
+
+uint64_t read_profiler_clock()
+{
+#ifdef PROFILER_X86
+    return __rdtsc();
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+void set_profiler_enabled(bool enabled)
+{
+    if (enabled && GLOBAL_profiler_base_ticks == 0) {
+        GLOBAL_profiler_base_time = std::chrono::steady_clock::now();
+        GLOBAL_profiler_base_ticks = read_profiler_clock();
+    }
+    GLOBAL_profiler_enabled.store(enabled, std::memory_order_relaxed);
+}
+
+bool is_profiler_enabled()
+{
+    return GLOBAL_profiler_enabled.load(std::memory_order_relaxed);
+}
+
+void set_profiler_thread_name(char const *name)
+{
+    snprintf(GLOBAL_current_profiler_thread_name, sizeof GLOBAL_current_profiler_thread_name, "%s", name);
+}
+
+static ::profiler_thread* register_profiler_thread()
+{
+    ::profiler_thread *thread = (::profiler_thread*)calloc(1, sizeof *thread);
+    thread->id = GLOBAL_profiler_thread_count.fetch_add(1);
+    if (GLOBAL_current_profiler_thread_name[0]) {
+        memcpy(thread->name, GLOBAL_current_profiler_thread_name, sizeof thread->name);
+    } else {
+        snprintf(thread->name, sizeof thread->name, "Thread %u", thread->id);
+    }
+
+    ::profiler_thread *head = GLOBAL_profiler_threads.load(std::memory_order_relaxed);
+    do {
+        thread->next = head;
+    } while (!GLOBAL_profiler_threads.compare_exchange_weak(head, thread, std::memory_order_release, std::memory_order_relaxed));
+
+    return thread;
+}
+
+void record_profiler_event(char const *name, uint64_t begin, uint64_t end)
+{
+    ::profiler_thread *thread = GLOBAL_current_profiler_thread;
+    if (thread == nullptr) {
+        thread = GLOBAL_current_profiler_thread = register_profiler_thread();
+    }
+
+    uint64_t head = thread->head.load(std::memory_order_relaxed);
+    ::profiler_event *event = &thread->events[head % PROFILER_RING_SIZE];
+    event->name.store(name, std::memory_order_relaxed);
+    event->begin.store(begin, std::memory_order_relaxed);
+    event->end.store(end, std::memory_order_relaxed);
+    thread->head.store(head + 1, std::memory_order_release);
+}
+
+double get_profiler_clock_frequency()
+{
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - GLOBAL_profiler_base_time).count();
+    if (GLOBAL_profiler_base_ticks == 0 || elapsed <= 0) {
+        return 1;
+    }
+    return (read_profiler_clock() - GLOBAL_profiler_base_ticks) / elapsed;
+}
+
+size_t read_profiler_thread_events(uint64_t since, ::profiler_record *records, size_t max_count)
+{
+    ::profiler_thread *thread = GLOBAL_current_profiler_thread;
+    if (thread == nullptr) {
+        return 0;
+    }
+
+    // Only this thread writes the ring, so it can be read directly
+    uint64_t head = thread->head.load(std::memory_order_relaxed);
+    uint64_t first = head;
+    while (first > 0 && head - first < PROFILER_RING_SIZE && head - first < max_count) {
+        if (thread->events[(first - 1) % PROFILER_RING_SIZE].end.load(std::memory_order_relaxed) < since) {
+            break;
+        }
+        first--;
+    }
+
+    for (uint64_t i = first; i < head; ++i) {
+        ::profiler_event const *event = &thread->events[i % PROFILER_RING_SIZE];
+        records[i - first] = {
+            event->name.load(std::memory_order_relaxed),
+            event->begin.load(std::memory_order_relaxed),
+            event->end.load(std::memory_order_relaxed),
+        };
+    }
+    return head - first;
+}
+
+static void write_json_string(FILE *file, char const *string)
+{
+    fputc('"', file);
+    for (; *string; ++string) {
+        if (*string == '"' || *string == '\\') {
+            fputc('\\', file);
+        }
+        fputc(*string, file);
+    }
+    fputc('"', file);
+}
+
+bool write_profiler_trace(char const *path)
+{
+    FILE *file = fopen(path, "w");
+    if (file == nullptr) {
+        fprintf(stderr, "Profiler: can not open %s\n", path);
+        return false;
+    }
+
+    // Calibrated against the steady clock over the whole time recorded
+    double ticks_per_us = get_profiler_clock_frequency() / 1e6;
+
+    static ::profiler_record copied[PROFILER_RING_SIZE];
+    size_t written = 0;
+
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    for (::profiler_thread *thread = GLOBAL_profiler_threads.load(std::memory_order_acquire); thread; thread = thread->next) {
+        fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%u,\"args\":{\"name\":", written ? ",\n" : "", thread->id);
+        write_json_string(file, thread->name);
+        fprintf(file, "}}");
+        written++;
+
+        uint64_t head = thread->head.load(std::memory_order_acquire);
+        uint64_t first = head > PROFILER_RING_SIZE ? head - PROFILER_RING_SIZE : 0;
+        for (uint64_t i = first; i < head; ++i) {
+            ::profiler_event const *event = &thread->events[i % PROFILER_RING_SIZE];
+            copied[i % PROFILER_RING_SIZE] = {
+                event->name.load(std::memory_order_relaxed),
+                event->begin.load(std::memory_order_relaxed),
+                event->end.load(std::memory_order_relaxed),
+            };
+        }
+
+        // The thread kept recording while copying, skip whatever it might have overwritten
+        std::atomic_thread_fence(std::memory_order_acquire);
+        uint64_t overwritten = thread->head.load(std::memory_order_relaxed);
+        if (overwritten > PROFILER_RING_SIZE && overwritten - PROFILER_RING_SIZE > first) {
+            first = overwritten - PROFILER_RING_SIZE;
+        }
+
+        for (uint64_t i = first; i < head; ++i) {
+            ::profiler_record const *event = &copied[i % PROFILER_RING_SIZE];
+            // Cores can disagree on the tick count a little
+            if (event->begin < GLOBAL_profiler_base_ticks || event->end < event->begin) {
+                continue;
+            }
+
+            fprintf(file, ",\n{\"name\":");
+            write_json_string(file, event->name);
+            fprintf(file, ",\"ph\":\"X\",\"pid\":0,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+                thread->id, (event->begin - GLOBAL_profiler_base_ticks) / ticks_per_us, (event->end - event->begin) / ticks_per_us);
+        }
+    }
+    fprintf(file, "\n]}\n");
+
+    bool ok = ferror(file) == 0;
+    fclose(file);
+    return ok;
+}
+
+void deinit_profiler()
+{
+    GLOBAL_profiler_enabled.store(false);
+    ::profiler_thread *thread = GLOBAL_profiler_threads.exchange(nullptr);
+    while (thread) {
+        ::profiler_thread *next = thread->next;
+        free(thread);
+        thread = next;
+    }
+    GLOBAL_profiler_thread_count.store(0);
+    GLOBAL_current_profiler_thread = nullptr;
+}
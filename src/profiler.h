@@ -0,0 +1,108 @@
+#ifndef CT_PROFILER_H
+#define CT_PROFILER_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Events kept per thread, the oldest ones get overwritten
+#define PROFILER_RING_SIZE (1 << 15)
+#define PROFILER_THREAD_NAME_SIZE 32
+
+// Fields are atomic so traces can be written while threads keep recording, stores are relaxed and cost the same as plain ones
+struct profiler_event {
+    std::atomic<char const*> name;
+    std::atomic<uint64_t> begin, end;
+};
+
+// A copy of an event, safe to read while the thread keeps recording
+struct profiler_record {
+    char const *name;
+    uint64_t begin, end;
+};
+
+// Ring buffer only its thread writes to, created on the first event the thread records
+struct profiler_thread {
+    uint32_t id;
+    char name[PROFILER_THREAD_NAME_SIZE];
+    // Events recorded so far, the ring holds the last PROFILER_RING_SIZE of them
+    std::atomic<uint64_t> head;
+    ::profiler_event events[PROFILER_RING_SIZE];
+    ::profiler_thread *next;
+};
+
+extern std::atomic<bool> GLOBAL_profiler_enabled;
+
+// Starts or stops recording, zones already open when it starts are not recorded
+void set_profiler_enabled(bool enabled);
+bool is_profiler_enabled();
+
+// Names the calling thread in traces, has to be called before it records anything
+void set_profiler_thread_name(char const *name);
+
+// Timestamp in CPU ticks, converted when the trace is written
+uint64_t read_profiler_clock();
+
+void record_profiler_event(char const *name, uint64_t begin, uint64_t end);
+
+// Ticks per second of read_profiler_clock, measured since recording first started
+double get_profiler_clock_frequency();
+
+/**
+ * @brief      Copies the events the calling thread recorded that ended at or after
+ *             since, in the order they ended (children before their parents).
+ *
+ * @param[in]  since      The earliest end, in ticks
+ * @param      records    The records
+ * @param[in]  max_count  The most records to copy, the newest are kept
+ *
+ * @return     The number of records copied
+ */
+size_t read_profiler_thread_events(uint64_t since, ::profiler_record *records, size_t max_count);
+
+/**
+ * @brief      Writes what the threads recorded as Chrome trace event JSON, which
+ *             chrome://tracing and Perfetto open.
+ *
+ * @param[in]  path  The path
+ *
+ * @return     Whether the file was written
+ */
+bool write_profiler_trace(char const *path);
+
+// Frees the thread buffers, no thread can record anymore after this
+void deinit_profiler();
+
+// Records the time between its construction and destruction, use PROFILE_ZONE
+struct profiler_zone {
+    char const *name;
+    uint64_t begin;
+
+    profiler_zone(char const *name)
+    {
+        this->name = GLOBAL_profiler_enabled.load(std::memory_order_relaxed) ? name : nullptr;
+        if (this->name) {
+            this->begin = read_profiler_clock();
+        }
+    }
+
+    ~profiler_zone()
+    {
+        if (this->name) {
+            record_profiler_event(this->name, this->begin, read_profiler_clock());
+        }
+    }
+};
+
+#define PROFILE_ZONE_CONCAT_(a, b) a##b
+#define PROFILE_ZONE_CONCAT(a, b) PROFILE_ZONE_CONCAT_(a, b)
+
+// Names have to outlive the trace, e.g. string literals
+#ifdef CT_PROFILER_DISABLE
+#define PROFILE_ZONE(name)
+#else
+#define PROFILE_ZONE(name) ::profiler_zone PROFILE_ZONE_CONCAT(profiler_zone_, __LINE__)(name)
+#endif
+#define PROFILE_FUNCTION() PROFILE_ZONE(__func__)
+
+#endif
@@ -0,0 +1,581 @@
+#include "render.h"
+#include "profiler.h"
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+extern "C" {
+#include "bin/shaders.h"
+}
+
+::combined_buffer_gpu make_gpu_combined_buffer(::combined_buffer const *buffer, ::render *render)
+{
+    assert(buffer->index_count > 0 && buffer->vertex_count > 0);
+    sg_buffer_desc index_buffer = {};
+    index_buffer.data = sg_range{buffer->indices, buffer->index_count * sizeof *buffer->indices};
+    index_buffer.type = SG_BUFFERTYPE_INDEXBUFFER;
+    index_buffer.label = "cube-indices";
+
+    sg_buffer_desc vertex_buffer = {};
+    vertex_buffer.data = sg_range{buffer->vertices, buffer->vertex_count * buffer->stride * sizeof *buffer->vertices};
+    vertex_buffer.label = "cube-vertices";
+
+    return {sg_make_buffer(&vertex_buffer), sg_make_buffer(&index_buffer), buffer->index_count};
+}
+
+// Writes a chunk buffer in place. It is made again, dynamic and with room to grow, if it is missing or too small,
+// or if it was written this frame already: sokol_gfx takes one update per buffer and frame.
+static void write_gpu_chunk_buffer(sg_buffer *buffer, size_t *capacity, bool writable, sg_range data, char const *label)
+{
+    assert(data.size > 0);
+    if (!buffer->id || !writable || *capacity < data.size) {
+        if (buffer->id) {
+            sg_destroy_buffer(*buffer);
+        }
+        size_t size = CHUNK_BUFFER_MIN_SIZE;
+        while (size < data.size) {
+            size *= 2;
+        }
+
+        sg_buffer_desc desc = {};
+        desc.size = size;
+        desc.usage = SG_USAGE_DYNAMIC;
+        desc.label = label;
+        *buffer = sg_make_buffer(&desc);
+        *capacity = size;
+    }
+    sg_update_buffer(*buffer, &data);
+}
+
+void destroy_gpu_combined_buffer(::combined_buffer_gpu *buffer)
+{
+    if (buffer->indices.id) {
+        sg_destroy_buffer(buffer->indices);
+    }
+    if (buffer->vertices.id) {
+        sg_destroy_buffer(buffer->vertices);
+    }
+    *buffer = {};
+}
+
+static sg_buffer make_quad_index_buffer()
+{
+    size_t size = CHUNK_MESH_MAX_QUADS*6 * sizeof(chunk_mesh_index);
+    chunk_mesh_index *indices = (chunk_mesh_index*)malloc(size);
+    get_chunk_mesh_quad_indices(indices);
+
+    sg_buffer_desc index_buffer = {};
+    index_buffer.data = sg_range{indices, size};
+    index_buffer.type = SG_BUFFERTYPE_INDEXBUFFER;
+    index_buffer.label = "quad-indices";
+    sg_buffer output = sg_make_buffer(&index_buffer);
+
+    free(indices);
+    return output;
+}
+
+::cube_mesh_cache init_cube_mesh_cache(::render *render)
+{
+    ::cube_mesh_cache output = {};
+    ::combined_buffer buffer = init_combined_buffer_malloc(8, 4*64*6, 6*64*6);
+
+    for (cube_side_flags flags = 1; flags < 64; ++flags) {
+        size_t start_index_offset = buffer.index_count;
+
+        if (flags & CUBE_SIDE_FLAG_PY) {
+            append_cube_quad_to_combined_buffer(&buffer, 0);
+        }
+        if (flags & CUBE_SIDE_FLAG_NX) {
+            append_cube_quad_to_combined_buffer(&buffer, 1);
+        }
+        if (flags & CUBE_SIDE_FLAG_PX) {
+            append_cube_quad_to_combined_buffer(&buffer, 2);
+        }
+        if (flags & CUBE_SIDE_FLAG_PZ) {
+            append_cube_quad_to_combined_buffer(&buffer, 3);
+        }
+        if (flags & CUBE_SIDE_FLAG_NZ) {
+            append_cube_quad_to_combined_buffer(&buffer, 4);
+        }
+        if (flags & CUBE_SIDE_FLAG_NY) {
+            append_cube_quad_to_combined_buffer(&buffer, 5);
+        }
+
+        output.index_offsets[flags] = start_index_offset;
+        output.index_sizes[flags] = buffer.index_count-start_index_offset;
+    }
+
+    output.buffer = make_gpu_combined_buffer(&buffer, render);
+
+    return output;
+}
+
+void uninit_cube_mesh_cache(::cube_mesh_cache *cmc) 
+{
+    destroy_gpu_combined_buffer(&cmc->buffer);
+}
+
+// Render states both pipelines share
+static sg_pipeline_desc get_pipeline_desc(::render const *render)
+{
+    sg_pipeline_desc pipeline_desc = {};
+    pipeline_desc.index_type = SG_INDEXTYPE_UINT16;
+    pipeline_desc.depth.write_enabled = true;
+    pipeline_desc.depth.compare = SG_COMPAREFUNC_LESS_EQUAL;
+    pipeline_desc.cull_mode = SG_CULLMODE_FRONT;
+    if (render->properties.wireframe_mode) {
+        pipeline_desc.primitive_type = SG_PRIMITIVETYPE_LINE_STRIP;
+    } else {
+        pipeline_desc.primitive_type = SG_PRIMITIVETYPE_TRIANGLES;
+    }
+    return pipeline_desc;
+}
+
+static void make_pipeline(sg_pipeline *pip, sg_pipeline_desc const *pipeline_desc)
+{
+    if (pip->id == 0) { // init new
+        *pip = sg_make_pipeline(pipeline_desc);
+    } else { // recreate
+        sg_uninit_pipeline(*pip);
+        sg_init_pipeline(*pip, pipeline_desc);
+    }
+}
+
+void init_render_pipeline(::render *render)
+{
+    /* if the vertex layout doesn't have gaps, don't need to provide strides and offsets */
+    sg_pipeline_desc pipeline_desc = get_pipeline_desc(render);
+    pipeline_desc.shader = render->shader;
+    pipeline_desc.label = "cube-pipeline";
+    pipeline_desc.layout.buffers[0].stride = 4*8;
+    pipeline_desc.layout.attrs[ATTR_vs_position].format = SG_VERTEXFORMAT_FLOAT3;
+    pipeline_desc.layout.attrs[ATTR_vs_normal].format = SG_VERTEXFORMAT_FLOAT3;
+    pipeline_desc.layout.attrs[ATTR_vs_uv].format = SG_VERTEXFORMAT_FLOAT2;
+    make_pipeline(&render->pip, &pipeline_desc);
+
+    // Bytes go in as floats from 0 to 255, GLES2 has no integer attributes
+    sg_pipeline_desc chunk_pipeline_desc = get_pipeline_desc(render);
+    chunk_pipeline_desc.shader = render->chunk_shader;
+    chunk_pipeline_desc.label = "chunk-pipeline";
+    chunk_pipeline_desc.index_type = CHUNK_MESH_INDEX_TYPE;
+    chunk_pipeline_desc.layout.buffers[0].stride = sizeof(::chunk_vertex);
+    chunk_pipeline_desc.layout.attrs[ATTR_chunk_vs_packed_position].format = SG_VERTEXFORMAT_UBYTE4;
+    chunk_pipeline_desc.layout.attrs[ATTR_chunk_vs_packed_uv].format = SG_VERTEXFORMAT_UBYTE4;
+    make_pipeline(&render->chunk_pip, &chunk_pipeline_desc);
+
+    sg_pipeline_desc voxel_pipeline_desc = get_pipeline_desc(render);
+    voxel_pipeline_desc.shader = render->voxel_shader;
+    voxel_pipeline_desc.label = "voxel-pipeline";
+    voxel_pipeline_desc.layout.buffers[0].stride = 4*8;
+    voxel_pipeline_desc.layout.buffers[1].stride = sizeof(::chunk_instance);
+    voxel_pipeline_desc.layout.buffers[1].step_func = SG_VERTEXSTEP_PER_INSTANCE;
+    voxel_pipeline_desc.layout.attrs[ATTR_voxel_vs_position].format = SG_VERTEXFORMAT_FLOAT3;
+    voxel_pipeline_desc.layout.attrs[ATTR_voxel_vs_normal].format = SG_VERTEXFORMAT_FLOAT3;
+    voxel_pipeline_desc.layout.attrs[ATTR_voxel_vs_uv].format = SG_VERTEXFORMAT_FLOAT2;
+    voxel_pipeline_desc.layout.attrs[ATTR_voxel_vs_instance].format = SG_VERTEXFORMAT_UBYTE4;
+    voxel_pipeline_desc.layout.attrs[ATTR_voxel_vs_instance].buffer_index = 1;
+    make_pipeline(&render->voxel_pip, &voxel_pipeline_desc);
+
+    printf("Created new pipelines %d, %d and %d\n", render->pip.id, render->chunk_pip.id, render->voxel_pip.id);
+}
+
+bool flush_render_pipeline(::render *render)
+{
+    // check if there's a reason to re initialize
+    if (memcmp(&render->previous_properties, &render->properties, sizeof render->properties) == 0) {
+        return false;
+    }
+
+    render->previous_properties = render->properties;
+
+    init_render_pipeline(render);
+    return true;
+}
+
+////////////
+// Render
+::render init_render(sg_context_desc context, sg_shader_desc const *shader_desc, sg_shader_desc const *chunk_shader_desc, sg_shader_desc const *voxel_shader_desc)
+{
+    ::render state = {};
+    sg_desc desc = {};
+    desc.context = context;
+    desc.buffer_pool_size = RENDER_BUFFER_POOL_SIZE;
+    sg_setup(&desc);
+
+    sg_buffer_desc index_buffer = {};
+    index_buffer.data = SG_RANGE(cube_indices);
+    index_buffer.type = SG_BUFFERTYPE_INDEXBUFFER;
+    index_buffer.label = "cube-indices";
+
+    sg_buffer_desc buffer_desc = {};
+    buffer_desc.data = SG_RANGE(cube_vertices);
+    buffer_desc.label = "cube-vertices";
+
+    state.cube_buffer = {sg_make_buffer(&buffer_desc), sg_make_buffer(&index_buffer), 6*6};
+    state.bind.index_buffer = state.cube_buffer.indices;
+    state.bind.vertex_buffers[0] = state.cube_buffer.vertices;
+
+    state.shader = sg_make_shader(shader_desc);
+    state.chunk_shader = sg_make_shader(chunk_shader_desc);
+    state.voxel_shader = sg_make_shader(voxel_shader_desc);
+    state.quad_indices = make_quad_index_buffer();
+
+    init_render_pipeline(&state);
+
+    /* a pass action to framebuffer to black */
+    state.pass_action = {};
+    state.pass_action.colors[0] = { .action=SG_ACTION_CLEAR, .value={0.0f, 0.0f, 0.0f, 1.0f } };
+
+    state.camera = camera::init(45);
+    return state;
+}
+
+void begin_render(::render *render, int width, int height) {
+    render->stats = {};
+    sg_begin_default_pass(render->pass_action, width, height);
+}
+
+void end_render(::render *render) {
+    PROFILE_FUNCTION();
+    sg_end_pass();
+    sg_commit();
+    render->frame_index++;
+}
+
+void set_bgcolor(::render *render, float color[3])
+{
+    render->pass_action.colors[0].value = sg_color{color[0], color[1], color[2], 1.0};
+}
+
+static void draw_elements(::render *render, int base_element, int element_count, int instance_count = 1)
+{
+    sg_draw(base_element, element_count, instance_count);
+    render->stats.draw_calls++;
+    render->stats.vertices += (size_t)element_count * instance_count;
+}
+
+void draw_cube_flags(::render *render, cube_side_flags flags)
+{
+    // FIXME(skejeton): this is a shit way to draw it
+    if (flags & CUBE_SIDE_FLAG_PY) {
+        draw_elements(render, 0, 6);
+    }
+    if (flags & CUBE_SIDE_FLAG_NX) {
+        draw_elements(render, 6, 6);
+    }
+    if (flags & CUBE_SIDE_FLAG_PX) {
+        draw_elements(render, 12, 6);
+    }
+    if (flags & CUBE_SIDE_FLAG_PZ) {
+        draw_elements(render, 18, 6);
+    }
+    if (flags & CUBE_SIDE_FLAG_NZ) {
+        draw_elements(render, 24, 6);
+    }
+    if (flags & CUBE_SIDE_FLAG_NY) {
+        draw_elements(render, 30, 6);
+    }
+
+}
+
+void draw_cube(::render *render, hmm_vec3 pos, cube_side_flags flags)
+{
+    if (flags == 0) {
+        return;
+    }
+    hmm_mat4 m_m = HMM_Translate(pos);
+    hmm_mat4 mvp = render->camera.get_vp() * m_m;
+
+    vs_params_t params = {};
+    memcpy(params.mvp, mvp.Elements, sizeof mvp.Elements);
+    auto params_range = SG_RANGE(params);
+
+    // DRAW USER STUFF
+    sg_apply_pipeline(render->pip);
+    sg_apply_bindings(&render->bind);
+    sg_apply_uniforms(SG_SHADERSTAGE_VS, SLOT_vs_params, &params_range);
+
+    draw_cube_flags(render, flags);
+}
+
+void update_world_meshes(::world *world, ::chunk_mesh_uploads *uploads, ::job_system *jobs, ::chunk_mesh_mode mode, bool instanced,
+                         ::job_counter *counter)
+{
+    PROFILE_FUNCTION();
+    // Best priority first, the workers steal the oldest jobs first
+    for (int n = 0; n < RENDER_DISTANCE*RENDER_DISTANCE*RENDER_DISTANCE; ++n) {
+        ::chunk *chunk = get_world_chunk_relative(world, world->priority_order[n]);
+        if (chunk && chunk->mesh_dirty) {
+            chunk->mesh_dirty = false;
+            submit_chunk_mesh_job(jobs, &uploads->baked, chunk, mode, instanced, counter);
+        }
+    }
+}
+
+void upload_chunk_mesh(::render *render, ::chunk_mesh_job const *job)
+{
+    ::chunk *chunk = job->chunk;
+
+    // The chunk changed or got recycled while the mesh was baked
+    if (job->mesh_version != chunk->mesh_version) {
+        return;
+    }
+    chunk->stage = CHUNK_STAGE_UPLOADED;
+    // An edit can rebuild a chunk that was uploaded earlier in the same frame
+    bool writable = chunk->upload_frame != render->frame_index;
+    chunk->upload_frame = render->frame_index;
+
+    // A chunk only keeps what it was last built as, baked or instanced, the buffer of that kind is rewritten
+    if (job->instanced) {
+        destroy_gpu_combined_buffer(&chunk->mesh);
+        chunk->mesh_capacity = 0;
+    } else if (chunk->instances.id) {
+        sg_destroy_buffer(chunk->instances);
+        chunk->instances = {};
+        chunk->instance_capacity = 0;
+    }
+    chunk->mesh.index_count = 0;
+    chunk->instance_count = 0;
+
+    if (job->buffer.vertex_count > 0) {
+        sg_range vertices = {job->buffer.vertices, job->buffer.vertex_count * sizeof *job->buffer.vertices};
+        write_gpu_chunk_buffer(&chunk->mesh.vertices, &chunk->mesh_capacity, writable, vertices, "chunk-vertices");
+        chunk->mesh.index_count = job->buffer.vertex_count/4*6;
+        memcpy(chunk->mesh_side_offsets, job->buffer.side_offsets, sizeof chunk->mesh_side_offsets);
+    }
+    if (job->instance_count > 0) {
+        sg_range instances = {job->instances, job->instance_count * sizeof *job->instances};
+        write_gpu_chunk_buffer(&chunk->instances, &chunk->instance_capacity, writable, instances, "chunk-instances");
+        chunk->instance_count = job->instance_count;
+    }
+}
+
+int upload_world_meshes(::render *render, ::chunk_mesh_uploads *uploads, double budget_seconds)
+{
+    PROFILE_FUNCTION();
+    auto start = std::chrono::steady_clock::now();
+
+    // Sorted into the backlog, so the budget goes to the chunks nearest to the camera and in view first
+    ::job_node *baked = take_job_results(&uploads->baked);
+    while (baked) {
+        ::job_node *next = baked->next;
+        float priority = ((::chunk_mesh_job*)baked)->chunk->priority;
+        ::job_node **link = &uploads->backlog;
+        while (*link && ((::chunk_mesh_job*)*link)->chunk->priority <= priority) {
+            link = &(*link)->next;
+        }
+        baked->next = *link;
+        *link = baked;
+        baked = next;
+    }
+
+    int uploaded = 0;
+    while (uploads->backlog) {
+        if (uploaded > 0 && std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() > budget_seconds) {
+            break;
+        }
+
+        ::chunk_mesh_job *job = (::chunk_mesh_job*)uploads->backlog;
+        uploads->backlog = job->node.next;
+
+        upload_chunk_mesh(render, job);
+        free_chunk_mesh_job(job);
+        uploaded++;
+    }
+
+    return uploaded;
+}
+
+void deinit_chunk_mesh_uploads(::chunk_mesh_uploads *uploads)
+{
+    ::job_node *jobs[2] = {take_job_results(&uploads->baked), uploads->backlog};
+    for (::job_node *node : jobs) {
+        while (node) {
+            ::job_node *next = node->next;
+            free_chunk_mesh_job((::chunk_mesh_job*)node);
+            node = next;
+        }
+    }
+    uploads->backlog = nullptr;
+}
+
+void deinit_world_meshes(::world *world)
+{
+    for (size_t i = 0; i < world->chunk_pool.capacity; ++i) {
+        ::chunk *chunk = &world->chunk_pool.slots[i];
+        destroy_gpu_combined_buffer(&chunk->mesh);
+        chunk->mesh_capacity = 0;
+        if (chunk->instances.id) {
+            sg_destroy_buffer(chunk->instances);
+        }
+        chunk->instances = {};
+        chunk->instance_capacity = 0;
+        chunk->instance_count = 0;
+    }
+}
+
+// Chunks are placed relative to the block the camera is in, so nothing far from it needs big floats
+struct chunk_draw_space {
+    hmm_mat4 vp;
+    vec3i eye_block;
+    hmm_vec3 eye_fraction;
+};
+
+static ::chunk_draw_space get_chunk_draw_space(::camera *camera)
+{
+    ::chunk_draw_space output;
+    hmm_vec3 eye = camera->position;
+    output.eye_block = {(int)floorf(eye.X), (int)floorf(eye.Y), (int)floorf(eye.Z)};
+    output.eye_fraction = eye - hmm_vec3{float(output.eye_block.x), float(output.eye_block.y), float(output.eye_block.z)};
+    hmm_mat4 view = camera->get_view();
+    view.Elements[3][0] = view.Elements[3][1] = view.Elements[3][2] = 0;
+    output.vp = camera->get_projection() * view;
+    return output;
+}
+
+static void get_chunk_offset(::chunk_draw_space const *space, ::chunk const *chunk, float output[4])
+{
+    vec3i origin = chunk->position * CHUNK_SIZE - space->eye_block;
+    output[0] = origin.x - space->eye_fraction.X;
+    output[1] = origin.y - space->eye_fraction.Y;
+    output[2] = origin.z - space->eye_fraction.Z;
+}
+
+// Sides of the blocks in a chunk that can look at the camera, from the chunk origin relative to the camera.
+// Blocks are centered on their position, so the faces of a side lie on planes half a block off the block centers.
+static cube_side_flags get_chunk_facing_sides(float const chunk_offset[4])
+{
+    cube_side_flags output = 0;
+    for (int axis = 0; axis < 3; ++axis) {
+        // The +axis face nearest to the camera's side of the chunk, and the -axis face farthest from it
+        if (chunk_offset[axis] + 0.5f < 0) {
+            output |= 1 << (axis*2);
+        }
+        if (chunk_offset[axis] + CHUNK_SIZE - 1.5f > 0) {
+            output |= 1 << (axis*2 + 1);
+        }
+    }
+    return output;
+}
+
+void draw_world(::render *render, ::world_visible_chunks const &visible)
+{
+    PROFILE_FUNCTION();
+    ::chunk_draw_space space = get_chunk_draw_space(&render->camera);
+
+    chunk_vs_params_t params = {};
+    memcpy(params.vp, space.vp.Elements, sizeof space.vp.Elements);
+    auto params_range = SG_RANGE(params);
+    sg_apply_pipeline(render->chunk_pip);
+
+    for (size_t i = 0; i < visible.count; ++i) {
+        ::chunk const *chunk = visible.chunks[i];
+        if (chunk->mesh.index_count == 0) {
+            continue;
+        }
+
+        get_chunk_offset(&space, chunk, params.chunk_offset);
+        cube_side_flags sides = get_chunk_facing_sides(params.chunk_offset);
+
+        sg_bindings bind = {};
+        bind.vertex_buffers[0] = chunk->mesh.vertices;
+        bind.index_buffer = render->quad_indices;
+
+        sg_apply_bindings(&bind);
+        sg_apply_uniforms(SG_SHADERSTAGE_VS, SLOT_chunk_vs_params, &params_range);
+
+        // One draw per run of neighbouring sides that face the camera
+        for (int side = 0; side < CUBE_SIDE_COUNT;) {
+            if ((sides & (1 << side)) == 0) {
+                side++;
+                continue;
+            }
+            int end = side + 1;
+            while (end < CUBE_SIDE_COUNT && (sides & (1 << end))) {
+                end++;
+            }
+            size_t first_quad = chunk->mesh_side_offsets[side], quad_count = chunk->mesh_side_offsets[end] - first_quad;
+            if (quad_count > 0) {
+                draw_elements(render, first_quad*6, quad_count*6);
+            }
+            side = end;
+        }
+    }
+}
+
+void draw_world_instanced(::render *render, ::world_visible_chunks const &visible)
+{
+    PROFILE_FUNCTION();
+    ::chunk_draw_space space = get_chunk_draw_space(&render->camera);
+
+    voxel_vs_params_t params = {};
+    memcpy(params.vp, space.vp.Elements, sizeof space.vp.Elements);
+    auto params_range = SG_RANGE(params);
+    sg_apply_pipeline(render->voxel_pip);
+
+    for (size_t i = 0; i < visible.count; ++i) {
+        ::chunk const *chunk = visible.chunks[i];
+        if (chunk->instance_count == 0) {
+            continue;
+        }
+
+        get_chunk_offset(&space, chunk, params.chunk_offset);
+
+        sg_bindings bind = {};
+        bind.vertex_buffers[0] = render->cube_buffer.vertices;
+        bind.vertex_buffers[1] = chunk->instances;
+        bind.index_buffer = render->cube_buffer.indices;
+        sg_apply_bindings(&bind);
+
+        // Every instance goes through every side facing the camera, the shader drops the sides a block does not show
+        cube_side_flags sides = get_chunk_facing_sides(params.chunk_offset);
+        for (size_t quad_no = 0; quad_no < 6; ++quad_no) {
+            if ((sides & cube_quad_side_flags[quad_no]) == 0) {
+                continue;
+            }
+            params.side[0] = cube_quad_side_flags[quad_no];
+            sg_apply_uniforms(SG_SHADERSTAGE_VS, SLOT_voxel_vs_params, &params_range);
+            draw_elements(render, quad_no*6, 6, chunk->instance_count);
+        }
+    }
+}
+
+void draw_world_per_voxel(::render *render, ::cube_mesh_cache *cube_mesh_cache, ::world_visible_chunks const &visible)
+{
+    PROFILE_FUNCTION();
+    // DRAW USER STUFF
+    vs_params_t params = {};
+    auto params_range = SG_RANGE(params);
+    sg_apply_pipeline(render->pip);
+
+    // FIXME(skejeton): I should move it somewhere else
+    render->bind.index_buffer = cube_mesh_cache->buffer.indices;
+    render->bind.vertex_buffers[0] = cube_mesh_cache->buffer.vertices;
+    sg_apply_bindings(&render->bind);
+
+    for (size_t i = 0; i < visible.count; ++i) {
+        ::chunk const *chunk = visible.chunks[i];
+        vec3i chunk_pos = chunk->position;
+        CHUNK_ITER(x, y, z) {
+            if (get_chunk_block(chunk, x, y, z)) {
+                cube_side_flags flags = get_chunk_side_flags(chunk, x, y, z);
+                if (flags == 0) {
+                    continue;
+                }
+                if (flags > 0b111111) {
+                    fprintf(stderr, "INVALID FLAGS!\n");
+                }
+                hmm_mat4 m_m = HMM_Translate({float(x+chunk_pos.x*CHUNK_SIZE), float(y+chunk_pos.y*CHUNK_SIZE), float(z+chunk_pos.z*CHUNK_SIZE)});
+                hmm_mat4 mvp = render->camera.get_vp() * m_m;
+
+                memcpy(params.mvp, mvp.Elements, sizeof mvp.Elements);
+                sg_apply_uniforms(SG_SHADERSTAGE_VS, SLOT_vs_params, &params_range);
+
+
+                draw_elements(render, cube_mesh_cache->index_offsets[flags], cube_mesh_cache->index_sizes[flags]);
+            }
+        }
+    }
+}
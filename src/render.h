@@ -0,0 +1,129 @@
+#ifndef CT_RENDER_H
+#define CT_RENDER_H
+
+#include <cstddef>
+#include "lib/sokol/sokol_gfx.h"
+#include "lib/HandmadeMath.h"
+#include "camera.h"
+#include "mesh.h"
+#include "world.h"
+#include "chunk_mesh.h"
+#include "jobs.h"
+
+// Smallest chunk buffer, they grow by doubling so a chunk that gains a few faces keeps its buffer
+#define CHUNK_BUFFER_MIN_SIZE 4096
+
+// Buffers sokol_gfx can hold at once, one per chunk mesh plus a few for the cubes, the quad indices and the UI
+#define RENDER_BUFFER_POOL_SIZE (RENDER_DISTANCE*RENDER_DISTANCE*RENDER_DISTANCE + 16)
+
+struct render_properties {
+    bool wireframe_mode;
+    bool disable_vsync;
+};
+
+// Counted since the last begin_render
+struct render_stats {
+    size_t draw_calls;
+    // Indices drawn times instances, each one runs the vertex shader
+    size_t vertices;
+};
+
+struct render {
+    sg_pipeline pip;
+    sg_shader shader;
+    // Baked chunk meshes, with chunk_vertex vertices
+    sg_pipeline chunk_pip;
+    sg_shader chunk_shader;
+    // Index buffer every chunk mesh is drawn with, see get_chunk_mesh_quad_indices
+    sg_buffer quad_indices;
+    // Instanced blocks, cube quads from cube_buffer with chunk_instance records
+    sg_pipeline voxel_pip;
+    sg_shader voxel_shader;
+    ::combined_buffer_gpu cube_buffer;
+    sg_bindings bind;
+    sg_pass_action pass_action;
+
+    ::render_properties previous_properties, properties;
+    ::camera camera;
+    ::render_stats stats;
+    // Counted up by end_render
+    uint32_t frame_index;
+};
+
+// Chunk meshes baked by the workers, waiting to be uploaded
+struct chunk_mesh_uploads {
+    ::job_result_list baked;
+    // Taken from the workers, but not uploaded yet, by chunk priority (see world::priorities)
+    ::job_node *backlog;
+};
+
+struct cube_mesh_cache {
+    combined_buffer_gpu buffer;
+    size_t index_offsets[64];
+    size_t index_sizes[64];
+};
+
+enum chunk_draw_mode {
+    CHUNK_DRAW_MODE_BAKED,
+    // Needs the chunks built with instances, see update_world_meshes
+    CHUNK_DRAW_MODE_INSTANCED,
+    CHUNK_DRAW_MODE_PER_VOXEL,
+    CHUNK_DRAW_MODE_COUNT
+};
+
+::combined_buffer_gpu make_gpu_combined_buffer(::combined_buffer const *buffer, ::render *render);
+void destroy_gpu_combined_buffer(::combined_buffer_gpu *buffer);
+
+/**
+ * @brief      Initializes the cube mesh cache with each permutation of a cube in it.
+ *
+ * @return     The cache
+ */
+::cube_mesh_cache init_cube_mesh_cache(::render *render);
+void uninit_cube_mesh_cache(::cube_mesh_cache *cmc);
+
+/**
+ * @brief      Sets up sokol_gfx and the cube, chunk and voxel pipelines. Nothing here depends on sokol_app,
+ *             so the same code runs in a window and headless on the dummy backend.
+ *
+ * @param[in]  context            The context from the windowing layer, empty when headless
+ * @param[in]  shader_desc        The cube shader for the backend in use
+ * @param[in]  chunk_shader_desc  The chunk shader for the backend in use
+ * @param[in]  voxel_shader_desc  The instanced voxel shader for the backend in use
+ *
+ * @return     The render
+ */
+::render init_render(sg_context_desc context, sg_shader_desc const *shader_desc, sg_shader_desc const *chunk_shader_desc, sg_shader_desc const *voxel_shader_desc);
+void init_render_pipeline(::render *render);
+
+// Recreates the pipeline if the properties changed, returns whether they did
+bool flush_render_pipeline(::render *render);
+
+void begin_render(::render *render, int width, int height);
+void end_render(::render *render);
+void set_bgcolor(::render *render, float color[3]);
+void draw_cube_flags(::render *render, cube_side_flags flags);
+void draw_cube(::render *render, hmm_vec3 pos, cube_side_flags flags);
+
+// Queues baking of outdated chunk meshes on the workers, or building their instances if instanced is set.
+// counter, if set, counts the queued jobs (see wait_for_counter).
+void update_world_meshes(::world *world, ::chunk_mesh_uploads *uploads, ::job_system *jobs, ::chunk_mesh_mode mode, bool instanced,
+                         ::job_counter *counter = nullptr);
+void upload_chunk_mesh(::render *render, ::chunk_mesh_job const *job);
+
+// Uploads meshes baked by the workers until the time budget runs out, at least one per call, best priority first
+int upload_world_meshes(::render *render, ::chunk_mesh_uploads *uploads, double budget_seconds);
+void deinit_chunk_mesh_uploads(::chunk_mesh_uploads *uploads);
+
+// Destroys the GPU buffers of every chunk in the pool, including recycled chunks that kept theirs
+void deinit_world_meshes(::world *world);
+
+void draw_world(::render *render, ::world_visible_chunks const &visible);
+
+// Draws the instances of each chunk, one instanced draw per cube side
+void draw_world_instanced(::render *render, ::world_visible_chunks const &visible);
+
+// Draws each voxel on its own, kept around to compare against baked chunk meshes
+void draw_world_per_voxel(::render *render, ::cube_mesh_cache *cube_mesh_cache, ::world_visible_chunks const &visible);
+
+#endif
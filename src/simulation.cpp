@@ -0,0 +1,60 @@
+#include "simulation.h"
+#include <cmath>
+#include "profiler.h"
+
+void init_simulation(::simulation *simulation, ::camera const *camera, float tick_rate)
+{
+    *simulation = {};
+    simulation->tick_rate = tick_rate;
+    simulation->camera = *camera;
+    simulation->previous_camera = *camera;
+}
+
+int advance_simulation(::simulation *simulation, ::input const &input, bool mouse_locked, double frame_duration)
+{
+    PROFILE_FUNCTION();
+    double tick_duration = 1.0 / simulation->tick_rate;
+    simulation->accumulator += frame_duration;
+    if (mouse_locked) {
+        simulation->pending_mouse_delta += input.mouse_delta;
+    }
+
+    int ticks = 0;
+    while (simulation->accumulator >= tick_duration) {
+        if (ticks == SIMULATION_MAX_TICKS_PER_FRAME) {
+            simulation->accumulator = fmod(simulation->accumulator, tick_duration);
+            break;
+        }
+
+        simulation->previous_camera = simulation->camera;
+        if (mouse_locked) {
+            ::input tick_input = input;
+            tick_input.mouse_delta = simulation->pending_mouse_delta;
+            handle_camera_input(&simulation->camera, tick_input, (float)tick_duration);
+        }
+        simulation->pending_mouse_delta = {0, 0};
+        simulation->accumulator -= tick_duration;
+        ++simulation->tick_count;
+        ++ticks;
+    }
+
+    simulation->frame_ticks = ticks;
+    return ticks;
+}
+
+::camera get_simulation_camera(::simulation const *simulation, float aspect)
+{
+    ::camera const *from = &simulation->previous_camera;
+    ::camera const *to = &simulation->camera;
+    float t = (float)(simulation->accumulator * simulation->tick_rate);
+
+    ::camera output = *to;
+    output.position = from->position + (to->position - from->position)*t;
+    // Yaw wraps around at 360 degrees, turn the short way
+    float yaw = fmodf(to->yaw_pitch.Y - from->yaw_pitch.Y + 540.0f, 360.0f) - 180.0f;
+    output.yaw_pitch.X = HMM_Lerp(from->yaw_pitch.X, t, to->yaw_pitch.X);
+    output.yaw_pitch.Y = from->yaw_pitch.Y + yaw*t;
+    output.dirty = true;
+    output.set_aspect(aspect);
+    return output;
+}
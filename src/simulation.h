@@ -0,0 +1,47 @@
+#ifndef CT_SIMULATION_H
+#define CT_SIMULATION_H
+
+#include <cstdint>
+#include "camera.h"
+#include "input.h"
+
+#define SIMULATION_DEFAULT_TICK_RATE 60
+// Ticks run per frame at most, a frame that takes longer drops the rest so a slow frame
+// can not make the next one even slower
+#define SIMULATION_MAX_TICKS_PER_FRAME 8
+
+// Advances the world in fixed ticks, however fast frames come
+struct simulation {
+    // Ticks per second
+    float tick_rate;
+    // Seconds of frame time not simulated yet, always less than a tick after advance_simulation
+    double accumulator;
+    // The camera after the previous tick and after the last one, frames are drawn in between
+    ::camera previous_camera;
+    ::camera camera;
+    // Mouse movement since the last tick, mouse look would be lost on frames without ticks otherwise
+    hmm_vec2 pending_mouse_delta;
+    uint64_t tick_count;
+    // Ticks run by the last advance_simulation
+    int frame_ticks;
+};
+
+// Starts over from a camera, with nothing left to simulate
+void init_simulation(::simulation *simulation, ::camera const *camera, float tick_rate);
+
+/**
+ * @brief      Runs the ticks a frame covers, each moving the camera by a tick's worth of input.
+ *
+ * @param      simulation      The simulation
+ * @param[in]  input           The input of the frame
+ * @param[in]  mouse_locked    Whether the input drives the camera
+ * @param[in]  frame_duration  Seconds since the previous frame
+ *
+ * @return     The number of ticks run
+ */
+int advance_simulation(::simulation *simulation, ::input const &input, bool mouse_locked, double frame_duration);
+
+// The camera where the frame falls between the last two ticks
+::camera get_simulation_camera(::simulation const *simulation, float aspect);
+
+#endif
@@ -0,0 +1,142 @@
+#include "terrain_column.h"
+#include "noise.h"
+#include "profiler.h"
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+
+const char *terrain_biome_names[TERRAIN_BIOME_COUNT] = {"Caverns", "Tunnels", "Solid"};
+
+// Ground height in blocks, TERRAIN_SURFACE_HEIGHT give or take TERRAIN_SURFACE_RANGE
+static const ::noise_params surface_noise = {NOISE_TYPE_FBM, 0x5EAF10E1, 1.0f/128, 3, 2.0f, 0.5f};
+#define TERRAIN_SURFACE_HEIGHT 24
+#define TERRAIN_SURFACE_RANGE 32
+// From 2 to 6 blocks
+static const ::noise_params crust_noise = {NOISE_TYPE_PERLIN, 0xC2057, 1.0f/24};
+static const ::noise_params biome_noise = {NOISE_TYPE_FBM, 0xB107E, 1.0f/256, 2, 2.0f, 0.5f};
+// The 2D fields are 3D noise cut at this height in blocks, away from y = 0 where every octave is on a lattice plane
+#define TERRAIN_NOISE_PLANE 1001.5f
+
+void generate_terrain_column(::terrain_column *output, int x, int z)
+{
+    PROFILE_FUNCTION();
+    output->x = x;
+    output->z = z;
+
+    const int count = CHUNK_SIZE*CHUNK_SIZE;
+    float xs[count], ys[count], zs[count], values[count];
+    for (int i = 0; i < CHUNK_SIZE; ++i) {
+        for (int k = 0; k < CHUNK_SIZE; ++k) {
+            xs[i*CHUNK_SIZE + k] = x*CHUNK_SIZE + i;
+            ys[i*CHUNK_SIZE + k] = TERRAIN_NOISE_PLANE;
+            zs[i*CHUNK_SIZE + k] = z*CHUNK_SIZE + k;
+        }
+    }
+
+    sample_noise(&surface_noise, xs, ys, zs, values, count);
+    output->highest_surface = INT32_MIN;
+    for (int i = 0; i < count; ++i) {
+        int surface = TERRAIN_SURFACE_HEIGHT + (int)floorf(values[i] * TERRAIN_SURFACE_RANGE);
+        output->surface[i/CHUNK_SIZE][i%CHUNK_SIZE] = surface;
+        output->highest_surface = HMM_MAX(output->highest_surface, surface);
+    }
+
+    sample_noise(&crust_noise, xs, ys, zs, values, count);
+    for (int i = 0; i < count; ++i) {
+        output->crust[i/CHUNK_SIZE][i%CHUNK_SIZE] = 4 + (int)floorf(values[i] * 2);
+    }
+
+    sample_noise(&biome_noise, xs, ys, zs, values, count);
+    for (int i = 0; i < count; ++i) {
+        ::terrain_biome biome = TERRAIN_BIOME_TUNNELS;
+        if (values[i] > 0.2f) {
+            biome = TERRAIN_BIOME_CAVERNS;
+        } else if (values[i] < -0.2f) {
+            biome = TERRAIN_BIOME_SOLID;
+        }
+        output->biomes[i/CHUNK_SIZE][i%CHUNK_SIZE] = biome;
+    }
+}
+
+void init_terrain_column_cache(::terrain_column_cache *cache, size_t capacity)
+{
+    cache->slots = (::terrain_column_slot*)calloc(capacity, sizeof *cache->slots);
+    cache->capacity = capacity;
+    cache->clock = 0;
+    cache->hits = 0;
+    cache->misses = 0;
+}
+
+void deinit_terrain_column_cache(::terrain_column_cache *cache)
+{
+    for (size_t i = 0; i < cache->capacity; ++i) {
+        assert(cache->slots[i].users == 0 && "Terrain column still held");
+    }
+    free(cache->slots);
+    cache->slots = nullptr;
+    cache->capacity = 0;
+}
+
+::terrain_column const* acquire_terrain_column(::terrain_column_cache *cache, int x, int z)
+{
+    std::unique_lock<std::mutex> lock(cache->mutex);
+
+    for (;;) {
+        ::terrain_column_slot *found = nullptr, *victim = nullptr;
+        for (size_t i = 0; i < cache->capacity; ++i) {
+            ::terrain_column_slot *slot = &cache->slots[i];
+            if (slot->used && slot->x == x && slot->z == z) {
+                found = slot;
+                break;
+            }
+            // Unused slots have last_used 0, so they go first
+            if (slot->users == 0 && (victim == nullptr || slot->last_used < victim->last_used)) {
+                victim = slot;
+            }
+        }
+
+        if (found) {
+            found->users++;
+            found->last_used = ++cache->clock;
+            cache->hits++;
+            // Another thread is still computing it
+            cache->changed.wait(lock, [found] { return found->ready; });
+            return &found->column;
+        }
+
+        if (victim == nullptr) {
+            // Every column is held, wait for one to be released
+            cache->changed.wait(lock);
+            continue;
+        }
+
+        victim->used = true;
+        victim->ready = false;
+        victim->users = 1;
+        victim->last_used = ++cache->clock;
+        victim->x = x;
+        victim->z = z;
+        cache->misses++;
+
+        // Other threads can look up other columns meanwhile, the slot is held so it stays ours
+        lock.unlock();
+        generate_terrain_column(&victim->column, x, z);
+        lock.lock();
+
+        victim->ready = true;
+        cache->changed.notify_all();
+        return &victim->column;
+    }
+}
+
+void release_terrain_column(::terrain_column_cache *cache, ::terrain_column const *column)
+{
+    ::terrain_column_slot *slot = (::terrain_column_slot*)column;
+    std::lock_guard<std::mutex> lock(cache->mutex);
+    assert(slot->users > 0 && "Terrain column released more often than acquired");
+    slot->users--;
+    if (slot->users == 0) {
+        cache->changed.notify_all();
+    }
+}
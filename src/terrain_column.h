@@ -0,0 +1,82 @@
+#ifndef CT_TERRAIN_COLUMN_H
+#define CT_TERRAIN_COLUMN_H
+
+#include "world.h"
+#include <condition_variable>
+#include <mutex>
+
+// Columns kept around, twice the columns of the view so moving back and forth does not recompute them
+#define TERRAIN_COLUMN_CACHE_CAPACITY (RENDER_DISTANCE*RENDER_DISTANCE*2)
+
+enum terrain_biome {
+    // Wide caves
+    TERRAIN_BIOME_CAVERNS,
+    TERRAIN_BIOME_TUNNELS,
+    // Mostly rock, with the odd pocket of air
+    TERRAIN_BIOME_SOLID,
+    TERRAIN_BIOME_COUNT
+};
+
+extern const char *terrain_biome_names[TERRAIN_BIOME_COUNT];
+
+// The 2D generation fields of a column of chunks, shared by every chunk stacked in it
+struct terrain_column {
+    // Position in chunk coordinates
+    int x, z;
+    // Height of the ground, in blocks, there are no blocks above it
+    //          x           z
+    int surface[CHUNK_SIZE][CHUNK_SIZE];
+    // The highest surface of the column, chunks above it are empty
+    int highest_surface;
+    // Blocks under the surface that caves do not break through
+    uint8_t crust[CHUNK_SIZE][CHUNK_SIZE];
+    uint8_t biomes[CHUNK_SIZE][CHUNK_SIZE];
+};
+
+// Computes the fields of the column of chunks at (x, z), in chunk coordinates. Safe to call from workers.
+void generate_terrain_column(::terrain_column *output, int x, int z);
+
+struct terrain_column_slot {
+    ::terrain_column column; // has to be first
+    // The column the slot holds, the fields of column itself are filled in outside the lock
+    int x, z;
+    bool used;
+    // Set once the fields are computed, until then other threads wait for them
+    bool ready;
+    // Threads holding the column, it is not evicted until they release it
+    int users;
+    // Value of terrain_column_cache::clock when it was last acquired
+    uint64_t last_used;
+};
+
+// Least recently used columns, filled in by whichever thread asks for a column first
+struct terrain_column_cache {
+    std::mutex mutex;
+    // Notified when a column got computed, or got released by its last user
+    std::condition_variable changed;
+    ::terrain_column_slot *slots;
+    size_t capacity;
+    uint64_t clock;
+
+    // Stats
+    size_t hits, misses;
+};
+
+void init_terrain_column_cache(::terrain_column_cache *cache, size_t capacity);
+// Nobody may be holding a column anymore
+void deinit_terrain_column_cache(::terrain_column_cache *cache);
+
+/**
+ * @brief      Gets the column of chunks at (x, z), computing it if it is not cached.
+ *             Waits if another thread is computing the same column. Safe to call from workers.
+ *
+ * @param      cache  The cache
+ * @param[in]  x      The x position, in chunks
+ * @param[in]  z      The z position, in chunks
+ *
+ * @return     The column, read-only and kept alive until release_terrain_column
+ */
+::terrain_column const* acquire_terrain_column(::terrain_column_cache *cache, int x, int z);
+void release_terrain_column(::terrain_column_cache *cache, ::terrain_column const *column);
+
+#endif
@@ -0,0 +1,895 @@
+#include "world.h"
+#include "face_mask.h"
+#include "noise.h"
+#include "terrain_column.h"
+#include "profiler.h"
+#include <cassert>
+#include <cfloat>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <chrono>
+
+vec3i operator%(vec3i v, int val)
+{
+    return {v.x%val, v.y%val, v.z%val};
+}
+
+vec3i operator+(vec3i v, vec3i u)
+{
+    return {v.x+u.x, v.y+u.y, v.z+u.z};
+}
+
+vec3i operator+(vec3i v, int u)
+{
+    return {v.x+u, v.y+u, v.z+u};
+}
+
+vec3i operator-(vec3i v, vec3i u)
+{
+    return {v.x-u.x, v.y-u.y, v.z-u.z};
+}
+
+vec3i operator-(vec3i v, int u)
+{
+    return {v.x-u, v.y-u, v.z-u};
+}
+
+vec3i operator*(vec3i v, int u)
+{
+    return {v.x*u, v.y*u, v.z*u};
+}
+
+vec3i operator*(vec3i v, vec3i u)
+{
+    return {v.x*u.x, v.y*u.y, v.z*u.z};
+}
+
+bool operator==(vec3i v, vec3i u)
+{
+    return v.x == u.x && v.y == u.y && v.z == u.z;
+}
+
+bool vec3i_check_bounds(vec3i v, vec3i p1, vec3i p2)
+{
+    return v.x >= p1.x && v.y >= p1.y && v.z >= p1.z && v.x < p2.x && v.y < p2.y && v.z < p2.z;
+}
+
+int vec3i_dot(vec3i v, vec3i u)
+{
+    return v.x*u.x+v.y*u.y+v.z*u.z;
+}
+
+const char *chunk_stage_names[CHUNK_STAGE_COUNT] = {"Empty", "Density", "Carved", "Decorated", "Lit", "Meshed", "Uploaded"};
+
+const ::chunk_stage chunk_stage_neighbours[CHUNK_STAGE_COUNT] = {
+    CHUNK_STAGE_EMPTY,
+    CHUNK_STAGE_EMPTY,
+    CHUNK_STAGE_EMPTY,
+    // Drip stones only look at their own chunk
+    CHUNK_STAGE_EMPTY,
+    // Light spreads across chunk borders
+    CHUNK_STAGE_DECORATED,
+    // Faces on the border depend on the blocks, and later the light, of the neighbours
+    CHUNK_STAGE_LIT,
+    CHUNK_STAGE_EMPTY,
+};
+
+// Neighbour of a block on each cube_side
+static const vec3i side_directions[CUBE_SIDE_COUNT] = {{1, 0, 0}, {-1, 0, 0}, {0, 1, 0}, {0, -1, 0}, {0, 0, 1}, {0, 0, -1}};
+
+static bool check_block_chunk(::chunk const *chunk, vec3i pos)
+{
+    // FIXME(skejeton): hack
+    if (pos.x < 0 || pos.y < 0 || pos.z < 0) {
+        return false;
+    }
+    return get_chunk_block(chunk, pos.x, pos.y, pos.z);
+}
+
+static int mod_positive(int value, int modulo)
+{
+    int result = value % modulo;
+    return result < 0 ? result + modulo : result;
+}
+
+static int floor_div(int value, int divisor)
+{
+    return (value - mod_positive(value, divisor)) / divisor;
+}
+
+// Slot of a chunk position in the world grid, the grid wraps around on every axis
+static vec3i get_world_storage_slot(vec3i chunk_pos)
+{
+    return {mod_positive(chunk_pos.x, RENDER_DISTANCE), mod_positive(chunk_pos.y, RENDER_DISTANCE), mod_positive(chunk_pos.z, RENDER_DISTANCE)};
+}
+
+// Gets the chunk at a position in chunk coordinates, nullptr if it is not in the world (yet)
+static ::chunk* find_world_chunk(::world const *world, vec3i chunk_pos)
+{
+    vec3i slot = get_world_storage_slot(chunk_pos);
+    ::chunk *chunk = world->chunks[slot.x][slot.y][slot.z];
+    // The slot might still hold a chunk from the other side of the view
+    if (chunk && chunk->position == chunk_pos) {
+        return chunk;
+    }
+    return nullptr;
+}
+
+static vec3i get_block_chunk_position(vec3i pos)
+{
+    return {floor_div(pos.x, CHUNK_SIZE), floor_div(pos.y, CHUNK_SIZE), floor_div(pos.z, CHUNK_SIZE)};
+}
+
+::chunk* get_world_chunk_relative(::world const *world, vec3i relative_chunk_pos)
+{
+    if (!vec3i_check_bounds(relative_chunk_pos, {0, 0, 0}, {RENDER_DISTANCE, RENDER_DISTANCE, RENDER_DISTANCE})) {
+        return nullptr;
+    }
+    vec3i slot = get_world_storage_slot(get_world_chunk_position(world, relative_chunk_pos));
+    return world->chunks[slot.x][slot.y][slot.z];
+}
+
+::chunk* get_world_chunk(::world const *world, vec3i pos)
+{
+    if (pos.x < 0 || pos.y < 0 || pos.z < 0) {
+        return nullptr;
+    }
+    return get_world_chunk_relative(world, {pos.x/CHUNK_SIZE, pos.y/CHUNK_SIZE, pos.z/CHUNK_SIZE});
+}
+
+bool check_block(::world const *world, vec3i pos)
+{
+    ::chunk *chunk = get_world_chunk(world, pos);
+    if (chunk) {
+        return check_block_chunk(chunk, pos%CHUNK_SIZE);
+    }
+    return false;
+}
+
+cube_side_flags get_side_flags(::world const *world, vec3i pos)
+{
+    cube_side_flags output = 0;
+
+    int i = 0;
+    for (auto neighbor : side_directions) {
+        output = output | ((cube_side_flags)(!check_block(world, pos+neighbor)) << i);
+        i++;
+    }
+
+    return output;
+}
+
+void generate_chunk_mesh_map(::world *world, vec3i relative_chunk_pos)
+{
+    ::chunk *chunk = get_world_chunk_relative(world, relative_chunk_pos);
+
+    // Missing neighbours count as empty, same as in check_block
+    static const ::chunk empty = {};
+    ::chunk const *neighbours[CUBE_SIDE_COUNT];
+    for (int side = 0; side < CUBE_SIDE_COUNT; ++side) {
+        neighbours[side] = get_world_chunk_relative(world, relative_chunk_pos+side_directions[side]);
+        if (neighbours[side] == nullptr) {
+            neighbours[side] = &empty;
+        }
+    }
+
+    compute_chunk_face_masks(chunk, neighbours);
+}
+
+void generate_chunk_mesh_map_scalar(::world *world, vec3i relative_chunk_pos)
+{
+    ::chunk *chunk = get_world_chunk_relative(world, relative_chunk_pos);
+    vec3i origin = relative_chunk_pos * CHUNK_SIZE;
+
+    memset(chunk->mesh_map, 0, sizeof chunk->mesh_map);
+
+    CHUNK_ITER(x, y, z) {
+        if (!get_chunk_block(chunk, x, y, z)) {
+            continue;
+        }
+
+        cube_side_flags flags = get_side_flags(world, origin + vec3i{x, y, z});
+        for (int side = 0; side < CUBE_SIDE_COUNT; ++side) {
+            chunk->mesh_map[side][x][z] |= chunk_column((flags >> side) & 1) << y;
+        }
+    }
+}
+
+bool get_block(::world const *world, vec3i pos)
+{
+    vec3i chunk_pos = get_block_chunk_position(pos);
+    ::chunk const *chunk = find_world_chunk(world, chunk_pos);
+    if (chunk == nullptr) {
+        return false;
+    }
+    vec3i local = pos - chunk_pos * CHUNK_SIZE;
+    return get_chunk_block(chunk, local.x, local.y, local.z);
+}
+
+// Recomputes the visible sides of one block in the mesh map of its chunk, and outdates the mesh if they changed
+static void update_block_mesh_map(::world *world, vec3i pos)
+{
+    vec3i chunk_pos = get_block_chunk_position(pos);
+    ::chunk *chunk = find_world_chunk(world, chunk_pos);
+    // Chunks not meshed yet get their whole mesh map computed anyway
+    if (chunk == nullptr || chunk->stage < CHUNK_STAGE_MESHED) {
+        return;
+    }
+
+    vec3i local = pos - chunk_pos * CHUNK_SIZE;
+    bool block = get_chunk_block(chunk, local.x, local.y, local.z);
+    chunk_column bit = chunk_column(1) << local.y;
+    bool changed = false;
+    for (int side = 0; side < CUBE_SIDE_COUNT; ++side) {
+        chunk_column *column = &chunk->mesh_map[side][local.x][local.z];
+        bool visible = block && !get_block(world, pos + side_directions[side]);
+        chunk_column updated = visible ? (*column | bit) : (*column & ~bit);
+        changed = changed || updated != *column;
+        *column = updated;
+    }
+
+    if (changed) {
+        chunk->mesh_dirty = true;
+        chunk->mesh_version++;
+    }
+}
+
+bool set_block(::world *world, vec3i pos, bool block)
+{
+    PROFILE_FUNCTION();
+    vec3i chunk_pos = get_block_chunk_position(pos);
+    ::chunk *chunk = find_world_chunk(world, chunk_pos);
+    if (chunk == nullptr) {
+        return false;
+    }
+
+    vec3i local = pos - chunk_pos * CHUNK_SIZE;
+    if (get_chunk_block(chunk, local.x, local.y, local.z) == block) {
+        return true;
+    }
+    set_chunk_block(chunk, local.x, local.y, local.z, block);
+
+    // Only the block and the faces its neighbours show towards it can change, in whichever chunk they are
+    update_block_mesh_map(world, pos);
+    for (int side = 0; side < CUBE_SIDE_COUNT; ++side) {
+        update_block_mesh_map(world, pos + side_directions[side]);
+    }
+    return true;
+}
+
+bool raycast_block(::world const *world, hmm_vec3 origin, hmm_vec3 direction, float max_distance, vec3i *hit, vec3i *before)
+{
+    // Blocks are centred on their position, so block n spans [n - 0.5, n + 0.5) on each axis
+    int block[3], step[3];
+    float next[3], delta[3];
+    for (int axis = 0; axis < 3; ++axis) {
+        float start = origin.Elements[axis] + 0.5f, d = direction.Elements[axis];
+        block[axis] = (int)floorf(start);
+        step[axis] = d > 0 ? 1 : -1;
+        // How far along the ray the next block border on this axis is, and how far apart the borders are
+        delta[axis] = d != 0 ? fabsf(1 / d) : INFINITY;
+        next[axis] = d != 0 ? (d > 0 ? block[axis] + 1 - start : start - block[axis]) * delta[axis] : INFINITY;
+    }
+
+    vec3i previous = {block[0], block[1], block[2]};
+    for (float distance = 0; distance <= max_distance;) {
+        vec3i pos = {block[0], block[1], block[2]};
+        if (get_block(world, pos)) {
+            *hit = pos;
+            *before = previous;
+            return true;
+        }
+        previous = pos;
+
+        int axis = next[0] < next[1] ? (next[0] < next[2] ? 0 : 2) : (next[1] < next[2] ? 1 : 2);
+        distance = next[axis];
+        block[axis] += step[axis];
+        next[axis] += delta[axis];
+    }
+    return false;
+}
+
+// A chunk in the view moving on to its next stage
+struct chunk_advance {
+    ::chunk *chunk;
+    vec3i relative_chunk_pos;
+};
+
+// Chunks within this many chunks of the view center get generated. Only the ones with all six neighbours
+// generated get meshed, the outermost ones are only there for those to be meshed against.
+#define WORLD_GENERATE_RADIUS (RENDER_DISTANCE/2 + 1)
+
+// Whether generate_world fills the slot, the view is one chunk shorter on the positive side
+static bool check_world_generated_slot(vec3i relative_chunk_pos)
+{
+    if (!vec3i_check_bounds(relative_chunk_pos, {0, 0, 0}, {RENDER_DISTANCE, RENDER_DISTANCE, RENDER_DISTANCE})) {
+        return false;
+    }
+    vec3i sphere_coords = relative_chunk_pos - (RENDER_DISTANCE/2);
+    return vec3i_dot(sphere_coords, sphere_coords) < WORLD_GENERATE_RADIUS*WORLD_GENERATE_RADIUS;
+}
+
+// Whether a chunk in the slot gets meshed, which takes all six neighbours generated. That is about the sphere
+// of radius RENDER_DISTANCE/2, less its layer on the positive side where the neighbours would be out of the grid.
+static bool check_world_meshed_slot(vec3i relative_chunk_pos)
+{
+    if (!check_world_generated_slot(relative_chunk_pos)) {
+        return false;
+    }
+    for (int side = 0; side < CUBE_SIDE_COUNT; ++side) {
+        if (!check_world_generated_slot(relative_chunk_pos+side_directions[side])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Whether the neighbours of a chunk are far enough along for it to enter stage
+static bool check_chunk_neighbours(::world const *world, vec3i relative_chunk_pos, ::chunk_stage stage)
+{
+    ::chunk_stage needed = chunk_stage_neighbours[stage];
+    if (needed == CHUNK_STAGE_EMPTY) {
+        return true;
+    }
+    for (int side = 0; side < CUBE_SIDE_COUNT; ++side) {
+        vec3i neighbour_pos = relative_chunk_pos+side_directions[side];
+        // Never coming. No light comes in from outside the view, but the faces towards it are unknown,
+        // so those chunks wait unmeshed until the view moves (see check_world_meshed_slot)
+        if (!check_world_generated_slot(neighbour_pos)) {
+            if (stage >= CHUNK_STAGE_MESHED) {
+                return false;
+            }
+            continue;
+        }
+        ::chunk const *neighbour = get_world_chunk_relative(world, neighbour_pos);
+        if (neighbour == nullptr || neighbour->stage < needed) {
+            return false;
+        }
+    }
+    return true;
+}
+
+struct world_advance {
+    ::world *world;
+    ::chunk_advance *advances;
+};
+
+static void run_chunk_advance(void *context, int i, int j, int k)
+{
+    (void)j;
+    (void)k;
+    ::world_advance *advance = (::world_advance*)context;
+    ::chunk_advance const *chunk = &advance->advances[i];
+
+    // Neighbours are only read, so chunks can be done in parallel
+    switch (chunk->chunk->stage + 1) {
+        case CHUNK_STAGE_LIT:
+            // Nothing is lit yet
+            break;
+        case CHUNK_STAGE_MESHED: {
+            PROFILE_ZONE("generate_chunk_mesh_map");
+            generate_chunk_mesh_map(advance->world, chunk->relative_chunk_pos);
+        } break;
+        default:
+            break;
+    }
+}
+
+int advance_world_chunks(::world *world, ::job_system *jobs)
+{
+    PROFILE_FUNCTION();
+    const int max_chunks = RENDER_DISTANCE*RENDER_DISTANCE*RENDER_DISTANCE;
+    vec3i const *order = world->priority_order;
+
+    // Picked up front and moved on after, so every chunk sees the stages its neighbours had before
+    ::chunk_advance advances[max_chunks];
+    int count = 0;
+    for (int n = 0; n < max_chunks; ++n) {
+        ::chunk *chunk = get_world_chunk_relative(world, order[n]);
+        // Uploading is up to the render
+        if (chunk == nullptr || chunk->stage >= CHUNK_STAGE_MESHED) {
+            continue;
+        }
+        if (check_chunk_neighbours(world, order[n], (::chunk_stage)(chunk->stage + 1))) {
+            advances[count++] = {chunk, order[n]};
+        }
+    }
+
+    // Most frames nothing changed, don't wake the workers for those
+    if (count == 0) {
+        return 0;
+    }
+
+    ::world_advance advance = {world, advances};
+    parallel_for_3d(jobs, count, 1, 1, WORLD_ADVANCE_GRAIN, run_chunk_advance, &advance);
+
+    for (int n = 0; n < count; ++n) {
+        ::chunk *chunk = advances[n].chunk;
+        chunk->stage = (::chunk_stage)(chunk->stage + 1);
+        if (chunk->stage == CHUNK_STAGE_MESHED) {
+            chunk->mesh_dirty = true;
+            chunk->mesh_version++;
+        }
+    }
+    return count;
+}
+
+// Density of the rock, blocks are set where it is above the threshold of their biome.
+// The lattice steps make it about 7x cheaper, with 1.5% of the blocks coming out differently (bench/noise).
+static const ::noise_params cave_noise = {NOISE_TYPE_FBM, 0xCA7E5EED, 1.0f/48, 4, 2.0f, 0.5f, {8, 4, 4, 2}};
+static const float cave_density_thresholds[TERRAIN_BIOME_COUNT] = {0.1f, -0.1f, -0.35f};
+
+// Blocks from the bottom of a column up to and including top
+static chunk_column get_column_mask_up_to(int top)
+{
+    if (top < 0) {
+        return 0;
+    }
+    if (top >= CHUNK_SIZE-1) {
+        return ~chunk_column(0);
+    }
+    return (chunk_column(1) << (top + 1)) - 1;
+}
+
+static uint32_t hash_chunk_column(vec3i chunk, int x, int z, uint32_t seed)
+{
+    uint32_t h = seed ^ (uint32_t)(chunk.x*CHUNK_SIZE + x)*0x8DA6B343u ^ (uint32_t)chunk.y*0xD8163841u ^ (uint32_t)(chunk.z*CHUNK_SIZE + z)*0xCB1AB31Fu;
+    // Finalizer of MurmurHash3, so the seeds come out unrelated
+    h ^= h >> 16;
+    h *= 0x85EBCA6Bu;
+    h ^= h >> 13;
+    h *= 0xC2B2AE35u;
+    return h ^ (h >> 16);
+}
+
+// CHUNK_STAGE_DENSITY
+static void fill_chunk_ground(::chunk *chunk, ::terrain_column const *column)
+{
+    int bottom = chunk->position.y * CHUNK_SIZE;
+    for (int x = 0; x < CHUNK_SIZE; ++x) {
+        for (int z = 0; z < CHUNK_SIZE; ++z) {
+            chunk->data[x][z] = get_column_mask_up_to(column->surface[x][z] - bottom);
+        }
+    }
+}
+
+// CHUNK_STAGE_CARVED
+static void carve_chunk_caves(::chunk *chunk, ::terrain_column const *column)
+{
+    int bottom = chunk->position.y * CHUNK_SIZE;
+    // Chunks above the ground are empty, no need to sample the caves
+    if (bottom > column->highest_surface) {
+        return;
+    }
+
+    // 128 KiB, too much for the stack of a worker
+    static thread_local chunk_density density;
+    sample_chunk_noise(&cave_noise, chunk->position, density);
+    for (int x = 0; x < CHUNK_SIZE; ++x) {
+        for (int z = 0; z < CHUNK_SIZE; ++z) {
+            float threshold = cave_density_thresholds[column->biomes[x][z]];
+            chunk_column caves = 0;
+            for (int y = 0; y < CHUNK_SIZE; ++y) {
+                caves |= chunk_column(density[x][z][y] <= threshold) << y;
+            }
+            // Caves stay under the crust
+            chunk->data[x][z] &= ~(caves & get_column_mask_up_to(column->surface[x][z] - column->crust[x][z] - bottom));
+        }
+    }
+}
+
+// CHUNK_STAGE_DECORATED
+static void decorate_chunk(::chunk *chunk, ::terrain_column const *column)
+{
+    int bottom = chunk->position.y * CHUNK_SIZE;
+    for (int x = 0; x < CHUNK_SIZE; ++x) {
+        for (int z = 0; z < CHUNK_SIZE; ++z) {
+            chunk_column rock = chunk->data[x][z];
+            chunk_column caves = ~rock & get_column_mask_up_to(column->surface[x][z] - column->crust[x][z] - bottom);
+            // Air under a ceiling and over a floor, within the chunk
+            chunk_column ceilings = caves & (rock >> 1), floors = caves & (rock << 1);
+
+            // One drip stone in 8 spots, one in 2 of those is 2 blocks long
+            chunk_column spots = hash_chunk_column(chunk->position, x, z, 1) & hash_chunk_column(chunk->position, x, z, 2) & hash_chunk_column(chunk->position, x, z, 3);
+            chunk_column long_ones = hash_chunk_column(chunk->position, x, z, 4);
+            chunk_column stalactites = ceilings & spots, stalagmites = floors & spots;
+            stalactites |= ((stalactites & long_ones) >> 1) & caves;
+            stalagmites |= ((stalagmites & long_ones) << 1) & caves;
+            chunk->data[x][z] = rock | stalactites | stalagmites;
+        }
+    }
+}
+
+void generate_chunk(::terrain_column_cache *columns, ::chunk *output, vec3i chunk)
+{
+    memset(output->mesh_map, 0, sizeof output->mesh_map);
+    output->position = chunk;
+    output->stage = CHUNK_STAGE_EMPTY;
+    output->mesh_dirty = false;
+    // The GPU buffers are kept for the next upload to rewrite, but the old mesh is not drawn anymore
+    output->mesh.index_count = 0;
+    output->instance_count = 0;
+
+    // Shared with the rest of the chunks stacked on this one
+    ::terrain_column const *column = acquire_terrain_column(columns, chunk.x, chunk.z);
+
+    // None of these look at the neighbours, so they run back to back
+    fill_chunk_ground(output, column);
+    output->stage = CHUNK_STAGE_DENSITY;
+    carve_chunk_caves(output, column);
+    output->stage = CHUNK_STAGE_CARVED;
+    decorate_chunk(output, column);
+    output->stage = CHUNK_STAGE_DECORATED;
+
+    release_terrain_column(columns, column);
+}
+
+vec3i get_world_chunk_position(::world const *world, vec3i relative_chunk_pos)
+{
+    return relative_chunk_pos - (RENDER_DISTANCE/2) + world->chunk_offset;
+}
+
+void put_world_chunk(::world *world, vec3i relative_chunk_pos, ::chunk *chunk)
+{
+    if (vec3i_check_bounds(relative_chunk_pos, {0, 0, 0}, {RENDER_DISTANCE, RENDER_DISTANCE, RENDER_DISTANCE})) {
+        vec3i slot = get_world_storage_slot(get_world_chunk_position(world, relative_chunk_pos));
+        world->chunks[slot.x][slot.y][slot.z] = chunk;
+    }
+}
+
+struct chunk_generate_job {
+    ::job_node node; // has to be first
+    // Set by the worker, from the best request in world::generate_queue
+    ::chunk *chunk;
+};
+
+// Min-heap order of chunk_request_queue
+static bool compare_chunk_requests(::chunk_request const &a, ::chunk_request const &b)
+{
+    return a.priority > b.priority;
+}
+
+static void run_chunk_generate_job(void *context, void *data)
+{
+    PROFILE_FUNCTION();
+    ::world *world = (::world*)context;
+    ::chunk_generate_job *job = (::chunk_generate_job*)data;
+
+    // Every job comes with a request, but not necessarily the one queued with it
+    ::chunk_request_queue *queue = world->generate_queue;
+    {
+        std::lock_guard<std::mutex> lock(queue->mutex);
+        assert(queue->count > 0 && "Generation job without a request");
+        std::pop_heap(queue->requests, queue->requests + queue->count, compare_chunk_requests);
+        job->chunk = queue->requests[--queue->count].chunk;
+    }
+
+    generate_chunk(world->terrain_columns, job->chunk, job->chunk->position);
+    push_job_result(&world->generated, &job->node);
+}
+
+void init_world(::world *world)
+{
+    // One chunk for every grid slot, so the pool can never run out
+    world->chunk_pool = init_chunk_pool(RENDER_DISTANCE*RENDER_DISTANCE*RENDER_DISTANCE, true);
+    world->terrain_columns = new ::terrain_column_cache;
+    init_terrain_column_cache(world->terrain_columns, TERRAIN_COLUMN_CACHE_CAPACITY);
+    world->generate_queue = new ::chunk_request_queue;
+    world->generate_queue->count = 0;
+    world->prioritized = false;
+    world->loading_in_view = 0;
+}
+
+static void free_job_nodes(::job_node *node)
+{
+    while (node) {
+        ::job_node *next = node->next;
+        free(node);
+        node = next;
+    }
+}
+
+void deinit_world(::world *world)
+{
+    free_job_nodes(take_job_results(&world->generated));
+    free_job_nodes(world->generated_backlog);
+    world->generated_backlog = nullptr;
+
+    deinit_chunk_pool(&world->chunk_pool);
+    deinit_terrain_column_cache(world->terrain_columns);
+    delete world->terrain_columns;
+    world->terrain_columns = nullptr;
+    assert(world->generate_queue->count == 0 && "Chunks still waiting for generation");
+    delete world->generate_queue;
+    world->generate_queue = nullptr;
+    memset(world->chunks, 0, sizeof world->chunks);
+    memset(world->pending, 0, sizeof world->pending);
+    world->chunk_offset = {};
+    world->generated_count = 0;
+}
+
+::chunk* alloc_world_chunk(::world *world)
+{
+    return acquire_chunk(&world->chunk_pool);
+}
+
+void release_world_chunk(::world *world, ::chunk *chunk)
+{
+    // Drop meshes still being baked for this chunk
+    chunk->mesh_version++;
+    release_chunk(&world->chunk_pool, chunk);
+}
+
+void change_world_chunk_offset(::world *world, vec3i new_chunk_offset)
+{
+    // Avoid waste of time
+    if (world->chunk_offset == new_chunk_offset) {
+        return;
+    }
+
+    vec3i old_min = get_world_chunk_position(world, {0, 0, 0});
+    int delta[3] = {new_chunk_offset.x-world->chunk_offset.x, new_chunk_offset.y-world->chunk_offset.y, new_chunk_offset.z-world->chunk_offset.z};
+    int min[3] = {old_min.x, old_min.y, old_min.z};
+
+    // Only the slabs that left the view are touched, the rest of the chunks keep their slots
+    for (int axis = 0; axis < 3; ++axis) {
+        int count = HMM_MIN(abs(delta[axis]), RENDER_DISTANCE);
+
+        for (int n = 0; n < count; ++n) {
+            int left = delta[axis] > 0 ? min[axis] + n : min[axis] + RENDER_DISTANCE-1 - n;
+            int slot[3];
+            slot[axis] = mod_positive(left, RENDER_DISTANCE);
+
+            const int u = (axis + 1) % 3, v = (axis + 2) % 3;
+            for (slot[u] = 0; slot[u] < RENDER_DISTANCE; ++slot[u]) {
+                for (slot[v] = 0; slot[v] < RENDER_DISTANCE; ++slot[v]) {
+                    ::chunk **chunk = &world->chunks[slot[0]][slot[1]][slot[2]];
+                    if (*chunk) {
+                        release_world_chunk(world, *chunk);
+                        *chunk = nullptr;
+                    }
+                }
+            }
+        }
+    }
+
+    world->chunk_offset = new_chunk_offset;
+}
+
+void change_world_chunk_offset_relative_to_camera(::world *world, camera *cam)
+{
+    PROFILE_FUNCTION();
+    change_world_chunk_offset(world, vec3i::from(cam->position/CHUNK_SIZE));
+} 
+
+int integrate_world_chunks(::world *world, double budget_seconds)
+{
+    PROFILE_FUNCTION();
+    auto start = std::chrono::steady_clock::now();
+
+    // Append what the workers finished since last time to the backlog
+    ::job_node *generated = take_job_results(&world->generated);
+    while (generated) {
+        ::job_node *next = generated->next;
+        generated->next = world->generated_backlog;
+        world->generated_backlog = generated;
+        generated = next;
+    }
+
+    int integrated = 0;
+    while (world->generated_backlog) {
+        if (integrated > 0 && std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() > budget_seconds) {
+            break;
+        }
+
+        ::chunk_generate_job *job = (::chunk_generate_job*)world->generated_backlog;
+        world->generated_backlog = job->node.next;
+
+        ::chunk *chunk = job->chunk;
+        free(job);
+
+        vec3i slot = get_world_storage_slot(chunk->position);
+        world->pending[slot.x][slot.y][slot.z] = nullptr;
+
+        // The view might have moved on while the chunk was generated
+        vec3i relative_chunk_pos = chunk->position - get_world_chunk_position(world, {0, 0, 0});
+        bool in_view = vec3i_check_bounds(relative_chunk_pos, {0, 0, 0}, {RENDER_DISTANCE, RENDER_DISTANCE, RENDER_DISTANCE});
+        if (!in_view || world->chunks[slot.x][slot.y][slot.z]) {
+            release_world_chunk(world, chunk);
+            continue;
+        }
+
+        world->chunks[slot.x][slot.y][slot.z] = chunk;
+        world->generated_count++;
+        integrated++;
+    }
+
+    return integrated;
+}
+
+// Lower goes first, chunks that left the view go last
+static float get_world_chunk_priority(::world const *world, vec3i chunk_pos)
+{
+    vec3i relative_chunk_pos = chunk_pos - get_world_chunk_position(world, {0, 0, 0});
+    if (!vec3i_check_bounds(relative_chunk_pos, {0, 0, 0}, {RENDER_DISTANCE, RENDER_DISTANCE, RENDER_DISTANCE})) {
+        return FLT_MAX;
+    }
+    return world->priorities[relative_chunk_pos.x][relative_chunk_pos.y][relative_chunk_pos.z];
+}
+
+// The box a chunk covers. Blocks are centred on their position, so a chunk spans half a block before its origin
+static void get_world_chunk_box(vec3i chunk_position, hmm_vec3 *min, hmm_vec3 *max)
+{
+    vec3i origin = chunk_position * CHUNK_SIZE;
+    *min = HMM_Vec3(origin.x - 0.5f, origin.y - 0.5f, origin.z - 0.5f);
+    *max = HMM_Vec3(origin.x + CHUNK_SIZE - 0.5f, origin.y + CHUNK_SIZE - 0.5f, origin.z + CHUNK_SIZE - 0.5f);
+}
+
+void prioritize_world_chunks(::world *world, camera *cam)
+{
+    PROFILE_FUNCTION();
+    hmm_mat4 vp = cam->get_vp();
+    // Nothing moved, the order is still good
+    if (world->prioritized && world->prioritized_chunk_offset == world->chunk_offset && memcmp(&vp, &world->prioritized_vp, sizeof vp) == 0) {
+        return;
+    }
+    world->prioritized = true;
+    world->prioritized_chunk_offset = world->chunk_offset;
+    world->prioritized_vp = vp;
+
+    const int max_chunks = RENDER_DISTANCE*RENDER_DISTANCE*RENDER_DISTANCE;
+    float min_x[max_chunks], min_y[max_chunks], min_z[max_chunks];
+    float max_x[max_chunks], max_y[max_chunks], max_z[max_chunks];
+    int count = 0;
+    WORLD_ITER(i, j, k) {
+        hmm_vec3 min, max;
+        get_world_chunk_box(get_world_chunk_position(world, {i, j, k}), &min, &max);
+        min_x[count] = min.X;
+        min_y[count] = min.Y;
+        min_z[count] = min.Z;
+        max_x[count] = max.X;
+        max_y[count] = max.Y;
+        max_z[count] = max.Z;
+        world->priority_order[count++] = {i, j, k};
+    }
+
+    // Same test as get_visible_world_chunks, so what is drawn first is what loads first
+    bool passed[max_chunks];
+    ::frustum_boxes boxes = {min_x, min_y, min_z, max_x, max_y, max_z, (size_t)count};
+    cull_frustum_boxes(&cam->get_frustum(), &boxes, passed);
+
+    for (int n = 0; n < count; ++n) {
+        vec3i slot = world->priority_order[n];
+        hmm_vec3 center = HMM_Vec3(min_x[n] + CHUNK_SIZE/2.0f, min_y[n] + CHUNK_SIZE/2.0f, min_z[n] + CHUNK_SIZE/2.0f);
+        hmm_vec3 to_camera = center - cam->position;
+        float priority = HMM_DotVec3(to_camera, to_camera);
+        world->priorities[slot.x][slot.y][slot.z] = passed[n] ? priority : priority * WORLD_HIDDEN_PRIORITY_SCALE;
+        world->in_frustum[slot.x][slot.y][slot.z] = passed[n];
+    }
+    std::stable_sort(world->priority_order, world->priority_order + count, [world](vec3i a, vec3i b) {
+        return world->priorities[a.x][a.y][a.z] < world->priorities[b.x][b.y][b.z];
+    });
+
+    // The workers take requests from the queue at any time, but it is only a couple hundred at most
+    ::chunk_request_queue *queue = world->generate_queue;
+    std::lock_guard<std::mutex> lock(queue->mutex);
+    for (size_t n = 0; n < queue->count; ++n) {
+        queue->requests[n].priority = get_world_chunk_priority(world, queue->requests[n].chunk->position);
+    }
+    std::make_heap(queue->requests, queue->requests + queue->count, compare_chunk_requests);
+}
+
+void generate_world(::world *world, ::job_system *jobs, camera *cam, ::job_counter *counter)
+{
+    PROFILE_FUNCTION();
+    prioritize_world_chunks(world, cam);
+
+    world->loading_in_view = 0;
+    for (int n = 0; n < RENDER_DISTANCE*RENDER_DISTANCE*RENDER_DISTANCE; ++n) {
+        vec3i relative_chunk_pos = world->priority_order[n];
+        vec3i chunk_pos = get_world_chunk_position(world, relative_chunk_pos);
+        vec3i slot = get_world_storage_slot(chunk_pos);
+        ::chunk *existing = world->chunks[slot.x][slot.y][slot.z];
+
+        if (existing) {
+            existing->priority = world->priorities[relative_chunk_pos.x][relative_chunk_pos.y][relative_chunk_pos.z];
+        }
+        if (check_world_meshed_slot(relative_chunk_pos) && world->in_frustum[relative_chunk_pos.x][relative_chunk_pos.y][relative_chunk_pos.z] &&
+            (existing == nullptr || existing->stage < CHUNK_STAGE_UPLOADED)) {
+            world->loading_in_view++;
+        }
+
+        // Only generate chunks in sphere
+        if (check_world_generated_slot(relative_chunk_pos)) {
+            // To not regenerate chunk after it's created, or while it's being generated
+            if (existing == nullptr && world->pending[slot.x][slot.y][slot.z] == nullptr) {
+                ::chunk *chunk = alloc_world_chunk(world);
+                if (chunk == nullptr) {
+                    continue;
+                }
+                chunk->position = chunk_pos;
+                chunk->priority = world->priorities[relative_chunk_pos.x][relative_chunk_pos.y][relative_chunk_pos.z];
+                world->pending[slot.x][slot.y][slot.z] = chunk;
+
+                ::chunk_request_queue *queue = world->generate_queue;
+                {
+                    std::lock_guard<std::mutex> lock(queue->mutex);
+                    queue->requests[queue->count++] = {chunk->priority, chunk};
+                    std::push_heap(queue->requests, queue->requests + queue->count, compare_chunk_requests);
+                }
+
+                ::chunk_generate_job *job = (::chunk_generate_job*)malloc(sizeof *job);
+                job->chunk = nullptr;
+                submit_job(jobs, {run_chunk_generate_job, world, job}, counter);
+            }
+        }
+    }
+    advance_world_chunks(world, jobs);
+}
+
+void mark_world_meshes_dirty(::world *world)
+{
+    WORLD_ITER(i, j, k) {
+        if (world->chunks[i][j][k] && world->chunks[i][j][k]->stage >= CHUNK_STAGE_MESHED) {
+            world->chunks[i][j][k]->mesh_dirty = true;
+            world->chunks[i][j][k]->mesh_version++;
+        }
+    }
+}
+
+void get_world_stage_counts(::world const *world, size_t counts[CHUNK_STAGE_COUNT])
+{
+    memset(counts, 0, CHUNK_STAGE_COUNT * sizeof *counts);
+    WORLD_ITER(i, j, k) {
+        if (world->chunks[i][j][k]) {
+            counts[world->chunks[i][j][k]->stage]++;
+        }
+        // The workers move these on, they count as empty until they are handed back
+        if (world->pending[i][j][k]) {
+            counts[CHUNK_STAGE_EMPTY]++;
+        }
+    }
+}
+
+void get_visible_world_chunks(::world const *world, ::frustum const *frustum, ::world_visible_chunks *visible)
+{
+    PROFILE_FUNCTION();
+    const size_t max_chunks = RENDER_DISTANCE*RENDER_DISTANCE*RENDER_DISTANCE;
+    ::chunk const *tested[max_chunks];
+    float min_x[max_chunks], min_y[max_chunks], min_z[max_chunks];
+    float max_x[max_chunks], max_y[max_chunks], max_z[max_chunks];
+
+    size_t count = 0;
+    WORLD_ITER(i, j, k) {
+        ::chunk const *chunk = world->chunks[i][j][k];
+        // Nothing to draw before the first upload
+        if (chunk == nullptr || chunk->stage < CHUNK_STAGE_UPLOADED) {
+            continue;
+        }
+
+        hmm_vec3 min, max;
+        get_world_chunk_box(chunk->position, &min, &max);
+        tested[count] = chunk;
+        min_x[count] = min.X;
+        min_y[count] = min.Y;
+        min_z[count] = min.Z;
+        max_x[count] = max.X;
+        max_y[count] = max.Y;
+        max_z[count] = max.Z;
+        count++;
+    }
+
+    bool passed[max_chunks];
+    ::frustum_boxes boxes = {min_x, min_y, min_z, max_x, max_y, max_z, count};
+    cull_frustum_boxes(frustum, &boxes, passed);
+
+    visible->count = 0;
+    visible->tested = count;
+    for (size_t i = 0; i < count; ++i) {
+        if (passed[i]) {
+            visible->chunks[visible->count++] = tested[i];
+        }
+    }
+}
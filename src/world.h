@@ -0,0 +1,312 @@
+#ifndef CT_WORLD_H
+#define CT_WORLD_H
+
+#include "lib/HandmadeMath.h"
+#include "camera.h"
+#include "mesh.h"
+#include "chunk_pool.h"
+#include "jobs.h"
+#include "frustum.h"
+
+struct terrain_column_cache;
+
+#define CHUNK_SIZE 32
+#define RENDER_DISTANCE 6
+// Chunks one job of advance_world_chunks moves on, a mesh map only takes a few microseconds
+#define WORLD_ADVANCE_GRAIN 4
+// Priority of chunks out of the view frustum is scaled by this, so they load as if they were twice as far away.
+// The ones in view go first, without leaving the ones right behind the camera for last.
+#define WORLD_HIDDEN_PRIORITY_SCALE 4.0f
+
+struct vec3i {
+    int x, y, z;
+
+    static vec3i from(hmm_vec3 v) {
+        return {int(v.X), int(v.Y), int(v.Z)};
+    }
+};
+
+// A column of blocks along y, bit y set = block set
+typedef uint32_t chunk_column;
+static_assert(CHUNK_SIZE == sizeof(chunk_column)*8, "A chunk column has to hold CHUNK_SIZE blocks");
+
+// Visible faces of set blocks, one column mask per cube_side
+//                                     side             x           z
+typedef chunk_column chunk_mesh_map[CUBE_SIDE_COUNT][CHUNK_SIZE][CHUNK_SIZE];
+
+// Where a chunk is in its life, a chunk only moves forward one stage at a time
+enum chunk_stage {
+    // Allocated, waiting for a worker
+    CHUNK_STAGE_EMPTY,
+    // Ground rock up to the surface of the terrain column
+    CHUNK_STAGE_DENSITY,
+    // Caves cut out of the rock with the cave noise
+    CHUNK_STAGE_CARVED,
+    // Drip stones hanging from the cave ceilings and growing from the floors
+    CHUNK_STAGE_DECORATED,
+    // The blocks are final. Nothing is lit yet, light would spread in from the neighbours here
+    CHUNK_STAGE_LIT,
+    // Mesh map computed against the final blocks of all six neighbours, the mesh is being baked
+    CHUNK_STAGE_MESHED,
+    // The baked mesh is on the GPU
+    CHUNK_STAGE_UPLOADED,
+    CHUNK_STAGE_COUNT
+};
+
+extern const char *chunk_stage_names[CHUNK_STAGE_COUNT];
+
+// The stage all six neighbours of a chunk have to be at before it can enter a stage,
+// CHUNK_STAGE_EMPTY for stages that do not look at the neighbours
+extern const ::chunk_stage chunk_stage_neighbours[CHUNK_STAGE_COUNT];
+
+struct chunk {
+    //              x           z
+    chunk_column data[CHUNK_SIZE][CHUNK_SIZE];
+    chunk_mesh_map mesh_map;
+    ::chunk_stage stage;
+    // Position in chunk coordinates
+    vec3i position;
+
+    // Baked geometry of the chunk, rebuilt from mesh_map when mesh_dirty is set
+    ::combined_buffer_gpu mesh;
+    // First quad of each cube_side in mesh, see chunk_mesh_buffer
+    size_t mesh_side_offsets[CUBE_SIDE_COUNT + 1];
+    // Blocks with visible faces as chunk_instance records, used instead of mesh when drawing instanced
+    sg_buffer instances;
+    size_t instance_count;
+    // Bytes the buffers above hold. They are dynamic and rewritten in place while the new contents fit.
+    size_t mesh_capacity, instance_capacity;
+    // render::frame_index of the last upload, see upload_chunk_mesh
+    uint32_t upload_frame;
+    bool mesh_dirty;
+    // Bumped on the main thread whenever the mesh gets outdated, meshes baked for older versions are dropped
+    uint32_t mesh_version;
+    // Of the slot the chunk is in, see world::priorities. Updated every generate_world.
+    float priority;
+};
+
+inline bool get_chunk_block(::chunk const *chunk, int x, int y, int z)
+{
+    return (chunk->data[x][z] >> y) & 1;
+}
+
+inline void set_chunk_block(::chunk *chunk, int x, int y, int z, bool block)
+{
+    if (block) {
+        chunk->data[x][z] |= chunk_column(1) << y;
+    } else {
+        chunk->data[x][z] &= ~(chunk_column(1) << y);
+    }
+}
+
+// Gathers the visible sides of a block from a mesh map
+inline cube_side_flags get_mesh_map_side_flags(chunk_mesh_map const &mesh_map, int x, int y, int z)
+{
+    cube_side_flags output = 0;
+    for (int side = 0; side < CUBE_SIDE_COUNT; ++side) {
+        output |= ((mesh_map[side][x][z] >> y) & 1) << side;
+    }
+    return output;
+}
+
+inline cube_side_flags get_chunk_side_flags(::chunk const *chunk, int x, int y, int z)
+{
+    return get_mesh_map_side_flags(chunk->mesh_map, x, y, z);
+}
+
+vec3i operator%(vec3i v, int val);
+vec3i operator+(vec3i v, vec3i u);
+vec3i operator+(vec3i v, int u);
+vec3i operator-(vec3i v, vec3i u);
+vec3i operator-(vec3i v, int u);
+vec3i operator*(vec3i v, int u);
+vec3i operator*(vec3i v, vec3i u);
+bool operator==(vec3i v, vec3i u);
+bool vec3i_check_bounds(vec3i v, vec3i p1, vec3i p2);
+int vec3i_dot(vec3i v, vec3i u);
+
+// A chunk waiting for a worker to generate it
+struct chunk_request {
+    float priority;
+    ::chunk *chunk;
+};
+
+// Min-heap of the chunks waiting to be generated. Generation jobs take the first request once a worker
+// runs them rather than when they are submitted, so requests can be reordered while they wait.
+struct chunk_request_queue {
+    std::mutex mutex;
+    ::chunk_request requests[RENDER_DISTANCE*RENDER_DISTANCE*RENDER_DISTANCE];
+    size_t count;
+};
+
+///////////
+// World 
+struct world {
+    // Addressed by chunk position modulo RENDER_DISTANCE on each axis, so moving
+    // around only replaces the chunks that went out of view.
+    // Use get_world_chunk_relative to look chunks up relative to the view.
+    ::chunk *chunks[RENDER_DISTANCE][RENDER_DISTANCE][RENDER_DISTANCE];
+    vec3i chunk_offset; 
+
+    // Every chunk of the world lives here, chunks that go out of view are recycled
+    ::chunk_pool chunk_pool;
+    // 2D fields of the chunk columns, shared by the workers generating chunks (see terrain_column.h)
+    ::terrain_column_cache *terrain_columns;
+
+    // Chunks going through the stages up to CHUNK_STAGE_DECORATED on a worker, by grid slot.
+    // They only join chunks once those are done, so nothing reads them while the worker writes.
+    ::chunk *pending[RENDER_DISTANCE][RENDER_DISTANCE][RENDER_DISTANCE];
+    // Generated chunks handed back from the workers
+    ::job_result_list generated;
+    // Generated chunks taken from the workers, but not integrated yet (main thread only)
+    ::job_node *generated_backlog;
+    // Chunks generated and integrated since init_world
+    size_t generated_count;
+
+    // Chunks pending generation, best priority first
+    ::chunk_request_queue *generate_queue;
+    // Priority of each slot relative to the view, lower goes first: the squared distance from the camera to
+    // the center of the chunk in blocks, times WORLD_HIDDEN_PRIORITY_SCALE out of the view frustum
+    float priorities[RENDER_DISTANCE][RENDER_DISTANCE][RENDER_DISTANCE];
+    bool in_frustum[RENDER_DISTANCE][RENDER_DISTANCE][RENDER_DISTANCE];
+    // Slots relative to the view, best priority first
+    vec3i priority_order[RENDER_DISTANCE*RENDER_DISTANCE*RENDER_DISTANCE];
+    // What the priorities were computed for, they are only recomputed once the camera moves
+    hmm_mat4 prioritized_vp;
+    vec3i prioritized_chunk_offset;
+    bool prioritized;
+    // Chunks in the view frustum and in the slots that get meshed, with nothing to draw yet, as of the last generate_world
+    size_t loading_in_view;
+};
+
+void init_world(::world *world);
+// The workers generating chunks must be stopped before this
+void deinit_world(::world *world);
+
+#define WORLD_ITER(x, y, z) for (int x = 0; x < RENDER_DISTANCE; ++x) for (int y = 0; y < RENDER_DISTANCE; ++y) for (int z = 0; z < RENDER_DISTANCE; ++z)
+#define CHUNK_ITER(x, y, z) for (int x = 0; x < CHUNK_SIZE; ++x) for (int y = 0; y < CHUNK_SIZE; ++y) for (int z = 0; z < CHUNK_SIZE; ++z)
+
+// Gets the chunk at a position relative to the view, in chunks
+::chunk* get_world_chunk_relative(::world const *world, vec3i relative_chunk_pos);
+// Gets the chunk holding a block, the position is relative to the view, in blocks
+::chunk* get_world_chunk(::world const *world, vec3i pos);
+bool check_block(::world const *world, vec3i pos);
+cube_side_flags get_side_flags(::world const *world, vec3i pos);
+
+/**
+ * @brief      Computes the mesh map of the chunk at a position relative to the view,
+ *             with shifts and masks over neighbouring columns (see face_mask.h).
+ *
+ * @param      world              The world
+ * @param[in]  relative_chunk_pos  The position of the chunk relative to the view, in chunks
+ */
+void generate_chunk_mesh_map(::world *world, vec3i relative_chunk_pos);
+
+// Gets a block by its position in blocks (not relative to the view), blocks of chunks not in the world are empty
+bool get_block(::world const *world, vec3i pos);
+
+/**
+ * @brief      Places or removes a block, by its position in blocks (not relative to the view).
+ *             Only the mesh map bits of the block and its six neighbours are updated, across chunk borders,
+ *             and only the chunks whose visible faces changed get their mesh rebuilt.
+ *
+ * @param      world  The world
+ * @param[in]  pos    The position of the block
+ * @param[in]  block  Whether the block is set
+ *
+ * @return     false if the chunk of the block is not in the world (yet), the block is left alone then
+ */
+bool set_block(::world *world, vec3i pos, bool block);
+
+/**
+ * @brief      Walks a ray block by block, up to the first set block.
+ *
+ * @param      world         The world
+ * @param[in]  origin        Where the ray starts, in world space
+ * @param[in]  direction     Where the ray goes, a unit vector
+ * @param[in]  max_distance  How far the ray goes, in blocks
+ * @param[out] hit           The first set block, by its position in blocks
+ * @param[out] before        The block the ray went through right before it, where a block placed against it goes
+ *
+ * @return     false if no block is set along the ray, chunks not in the world count as empty
+ */
+bool raycast_block(::world const *world, hmm_vec3 origin, hmm_vec3 direction, float max_distance, vec3i *hit, vec3i *before);
+
+// Same as generate_chunk_mesh_map, but block by block through get_side_flags. Used as a reference.
+void generate_chunk_mesh_map_scalar(::world *world, vec3i relative_chunk_pos);
+
+/**
+ * @brief      Moves chunks in the view that are done with the worker stages one stage further, if their
+ *             neighbours are far enough along. Those stages read the neighbours, so they run spread over
+ *             the job system, but this only returns once all of them are done.
+ *
+ * @param      world  The world
+ * @param      jobs   The job system
+ *
+ * @return     The number of chunks that moved on
+ */
+int advance_world_chunks(::world *world, ::job_system *jobs);
+
+/**
+ * @brief      Takes a chunk through the stages that do not need neighbours, up to CHUNK_STAGE_DECORATED,
+ *             from noise (see noise.h) in place. Safe to call from workers.
+ *
+ * @param      columns  The terrain columns the chunk's column is taken from
+ * @param      output   The chunk, its GPU buffers are kept around to be replaced on upload
+ * @param[in]  chunk    The position of the chunk, in chunk coordinates
+ */
+void generate_chunk(::terrain_column_cache *columns, ::chunk *output, vec3i chunk);
+// Returns nullptr if the chunk pool is out of chunks
+::chunk* alloc_world_chunk(::world *world);
+void release_world_chunk(::world *world, ::chunk *chunk);
+void put_world_chunk(::world *world, vec3i relative_chunk_pos, ::chunk *chunk);
+void change_world_chunk_offset(::world *world, vec3i new_chunk_offset);
+void change_world_chunk_offset_relative_to_camera(::world *world, camera *cam);
+
+/**
+ * @brief      Moves chunks generated by the workers into the world, until the time budget runs out.
+ *             At least one chunk is integrated per call, so streaming never stalls completely.
+ *
+ * @param      world           The world
+ * @param[in]  budget_seconds  The time budget
+ *
+ * @return     The number of chunks integrated
+ */
+int integrate_world_chunks(::world *world, double budget_seconds);
+
+/**
+ * @brief      Recomputes the priorities of the slots of the view, if the camera or the view moved since
+ *             last time, and reorders the chunks waiting for generation to match.
+ *
+ * @param      world  The world
+ * @param      cam    The camera chunks get loaded around
+ */
+void prioritize_world_chunks(::world *world, camera *cam);
+
+// Queues generation of missing chunks on the workers and advances the chunks in the view, by priority around cam.
+// counter, if set, counts the queued generation jobs (see wait_for_counter).
+void generate_world(::world *world, ::job_system *jobs, camera *cam, ::job_counter *counter = nullptr);
+
+// Makes every meshed chunk rebake its mesh, e.g. after the meshing mode changed
+void mark_world_meshes_dirty(::world *world);
+
+// Counts the chunks at each stage, in the view or on the workers
+void get_world_stage_counts(::world const *world, size_t counts[CHUNK_STAGE_COUNT]);
+
+/**
+ * @brief      Gets the position of a chunk in chunk coordinates from its position relative to the view.
+ */
+vec3i get_world_chunk_position(::world const *world, vec3i relative_chunk_pos);
+
+// Chunks that passed frustum culling, in WORLD_ITER order
+struct world_visible_chunks {
+    ::chunk const *chunks[RENDER_DISTANCE*RENDER_DISTANCE*RENDER_DISTANCE];
+    size_t count;
+    // The chunks tested, empty slots are not
+    size_t tested;
+};
+
+// Culls the chunks of the view against the frustum, a batch of chunk boxes at a time
+void get_visible_world_chunks(::world const *world, ::frustum const *frustum, ::world_visible_chunks *visible);
+
+#endif